@@ -1,30 +1,94 @@
 #include "app.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <memory>
+
+#include "arena.hpp"
 #include "board_analyzer.hpp"
 #include "game.hpp"
 
 namespace cli {
-  void App::Analyze() {
-    cli::BoardAnalyzer board_analyzer(opening_book, warmup_book);
+  App::Session App::StartSession() const {
+    using hr_clock = std::chrono::high_resolution_clock;
+    Session session;
+    const auto load_start = hr_clock::now();
+    session.books = std::make_shared<BookSource>(opening_book, warmup_book);
+    const auto load_end = hr_clock::now();
+    const std::chrono::duration<double> load_taken = load_end - load_start;
+
+    const auto book = session.books->Get();
+    std::cout << "Opening book: loaded " << book->GetOpeningCount()
+              << " moves.\n";
+    std::cout << "Warmup book: loaded " << book->GetWarmupCount()
+              << " moves.\n";
+    std::cout << "Books loaded in " << load_taken.count() << " seconds.\n";
+    std::cout.flush();
+
+    session.reloader = std::make_unique<BookReloader>(session.books);
+    if (config.solved_log && !solved_book.empty()) {
+      // the books only need a reload when the solver reads the solved book
+      session.compactor = std::make_unique<LogCompactor>(
+          config.solved_log, solved_book, compact_interval,
+          solved_book == warmup_book ? session.books : nullptr,
+          [book = solved_book](const CompactionReport &report) {
+            if (!report.ok) {
+              std::cerr << "\nSolved log compaction failed: " << report.error
+                        << '\n';
+            } else if (report.added != 0) {
+              std::cerr << "\nCompacted " << report.log_records
+                        << " solved positions into " << book << " in "
+                        << report.seconds << " seconds: " << report.added
+                        << " added, " << report.duplicates << " duplicates, "
+                        << report.conflicts << " conflicts, "
+                        << report.book_size << " positions.\n";
+            }
+          });
+    }
+    return session;
+  }
+
+  void App::Analyze(const bool details) {
+    const Session session = StartSession();
+    cli::BoardAnalyzer board_analyzer(session.books, config);
+    board_analyzer.SetShowDetails(details);
     board_analyzer.Run();
   }
 
+  void App::AnalyzeGame(const bool compare, const bool details) {
+    const Session session = StartSession();
+    cli::BoardAnalyzer board_analyzer(session.books, config);
+    board_analyzer.SetShowDetails(details);
+    board_analyzer.RunGameAnalysis(compare);
+  }
+
   void App::FindBestMove() {
-    cli::BoardAnalyzer board_analyzer(opening_book, warmup_book);
+    const Session session = StartSession();
+    cli::BoardAnalyzer board_analyzer(session.books, config);
     board_analyzer.Run();
   }
 
   void App::StartGame() {
-    Game game(opening_book, warmup_book);
+    const Session session = StartSession();
+    Game game(session.books, config);
     game.StartPlayerVsBotGame();
   }
 
   void App::StartBotGame() {
-    Game game(opening_book, warmup_book);
+    const Session session = StartSession();
+    Game game(session.books, config);
     game.StartBotGame();
   }
 
   void App::StartTraining() {
-    Game game(opening_book, warmup_book);
+    const Session session = StartSession();
+    Game game(session.books, config);
     game.StartTraining();
   }
+
+  void App::StartArena(const ArenaSettings& settings) {
+    const Session session = StartSession();
+    Arena arena(session.books, settings);
+    arena.Run();
+  }
 }  // namespace cli
@@ -1,21 +1,57 @@
 #pragma once
 
+#include <chrono>
+#include <memory>
 #include <string>
 
+#include "arena.hpp"
+#include "book_reloader.hpp"
+#include "core/book_compactor.hpp"
+#include "core/book_source.hpp"
+#include "core/solver.hpp"
+
 namespace cli {
 class App {
  public:
-  explicit App(const std::string& opening_book, const std::string& warmup_book)
-      : opening_book(opening_book), warmup_book(warmup_book) {}
+  explicit App(const std::string& opening_book, const std::string& warmup_book,
+               const SolverConfig& solver_config = {})
+      : opening_book(opening_book),
+        warmup_book(warmup_book),
+        config(solver_config) {}
+
+  // book config.solved_log is merged into, and how often
+  void SetCompaction(const std::string& book,
+                     const std::chrono::seconds interval) {
+    solved_book = book;
+    compact_interval = interval;
+  }
 
-  void Analyze();
+  // details: also print the principal variation and the shared table
+  // statistics after each query
+  void Analyze(bool details);
+  void AnalyzeGame(bool compare, bool details);
   void FindBestMove();
   void StartGame();
   void StartBotGame();
   void StartTraining();
+  void StartArena(const ArenaSettings& settings);
 
  private:
+  // Books of a mode, reloaded on SIGHUP and grown from the solved log
+  struct Session {
+    std::shared_ptr<BookSource> books;
+    std::unique_ptr<BookReloader> reloader;
+    std::unique_ptr<LogCompactor> compactor;
+  };
+
   std::string opening_book;
   std::string warmup_book;
+  SolverConfig config;
+  std::string solved_book;
+  std::chrono::seconds compact_interval{60};
+
+  // Load the books and print how long it took, then start reloading them on
+  // SIGHUP and compacting the solved log into the solved book
+  Session StartSession() const;
 };
 }  // namespace cli
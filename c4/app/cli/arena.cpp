@@ -0,0 +1,306 @@
+#include "arena.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/cost_model.hpp"
+#include "core/position.hpp"
+#include "core/solver.hpp"
+
+namespace cli {
+bool ParseEngineSettings(const std::string &description,
+                         EngineSettings &engine) {
+  engine.description = description.empty() ? "default" : description;
+
+  std::istringstream stream(description);
+  std::string setting;
+  while (std::getline(stream, setting, ',')) {
+    const size_t equal = setting.find('=');
+    const std::string key = setting.substr(0, equal);
+    const std::string value =
+        equal == std::string::npos ? "" : setting.substr(equal + 1);
+    try {
+      if (key == "table" && !value.empty()) {
+        engine.config.table_size = std::stoull(value);
+      } else if (key == "near-leaf" && !value.empty()) {
+        engine.config.near_leaf_table_size = std::stoull(value);
+      } else if (key == "near-leaf-ply" && !value.empty()) {
+        engine.config.near_leaf_ply = std::stoi(value);
+      } else if (key == "endgame" && !value.empty()) {
+        engine.config.endgame_threshold = std::stoi(value);
+      } else if (key == "weak" && value.empty()) {
+        engine.config.weak = true;
+      } else if (key == "parity" && value.empty()) {
+        engine.config.move_ordering = MoveOrdering::kThreatParity;
+      } else if (key == "forcing" && value.empty()) {
+        engine.config.forcing_search = true;
+      } else if (key == "etc" && value.empty()) {
+        engine.config.enhanced_cutoffs = true;
+      } else if (key == "zugzwang" && value.empty()) {
+        engine.config.zugzwang_rules = true;
+      } else if (key == "pn" && value.empty()) {
+        engine.config.backend = SearchBackend::kProofNumber;
+      } else if (key == "pn-nodes" && !value.empty()) {
+        engine.config.proof_nodes = std::stoull(value);
+      } else if (key == "budget" && !value.empty()) {
+        engine.limits.max_time = std::chrono::milliseconds(std::stoll(value));
+      } else if (key == "nodes" && !value.empty()) {
+        engine.limits.max_nodes = std::stoull(value);
+      } else if (!key.empty()) {
+        std::cerr << "Unknown engine setting: " << setting << '\n';
+        return false;
+      }
+    } catch (const std::logic_error &) {
+      std::cerr << "Invalid engine setting: " << setting << '\n';
+      return false;
+    }
+  }
+  return engine.config.table_size > 0;
+}
+
+void Arena::EngineStats::AddMove(const double time_taken) {
+  moves++;
+  time_ms += time_taken;
+  max_ms = std::max(max_ms, time_taken);
+  int bucket = 0;
+  for (auto us = static_cast<uint64_t>(time_taken * 1000);
+       us > 1 && bucket < LATENCY_BUCKETS - 1; us >>= 1) {
+    bucket++;
+  }
+  latency.at(bucket)++;
+}
+
+void Arena::EngineStats::Merge(const EngineStats &other) {
+  for (size_t color = 0; color < results.size(); color++) {
+    for (size_t outcome = 0; outcome < results[color].size(); outcome++) {
+      results.at(color).at(outcome) += other.results.at(color).at(outcome);
+    }
+  }
+  moves += other.moves;
+  stopped_moves += other.stopped_moves;
+  nodes += other.nodes;
+  time_ms += other.time_ms;
+  max_ms = std::max(max_ms, other.max_ms);
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    latency.at(i) += other.latency.at(i);
+  }
+}
+
+// upper bound, in milliseconds, of the latency bucket holding the percentile
+double Arena::EngineStats::Percentile(const double fraction) const {
+  const auto target = static_cast<uint64_t>(fraction * moves);
+  uint64_t seen = 0;
+  for (int i = 0; i < LATENCY_BUCKETS; i++) {
+    seen += latency.at(i);
+    if (seen > target) {
+      return static_cast<double>(UINT64_C(2) << i) / 1000;
+    }
+  }
+  return max_ms;
+}
+
+void Arena::Run() {
+  std::cout << "Arena: " << settings.games << " games on " << settings.threads
+            << " threads, " << settings.random_plies
+            << " random opening moves, seed " << settings.seed << ".\n";
+  for (size_t i = 0; i < settings.engines.size(); i++) {
+    std::cout << "Engine " << static_cast<char>('A' + i) << ": "
+              << settings.engines.at(i).description << '\n';
+  }
+  std::cout.flush();
+
+  const auto start = std::chrono::high_resolution_clock::now();
+  const CostModel cost_model;
+  const auto book = books->Get();
+  std::vector<double> costs(settings.games);
+  for (int game = 0; game < settings.games; game++) {
+    costs.at(game) = cost_model.Predict(OpeningPosition(game), book.get());
+  }
+  game_order.clear();
+  for (const size_t game : OrderLongestFirst(costs)) {
+    game_order.push_back(static_cast<int>(game));
+  }
+
+  std::vector<std::thread> threads;
+  for (unsigned int i = 0; i < settings.threads; i++) {
+    threads.emplace_back(&Arena::RunWorker, this);
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const auto end = std::chrono::high_resolution_clock::now();
+  const std::chrono::duration<double> time_taken = end - start;
+
+  PrintReport(time_taken.count());
+}
+
+void Arena::RunWorker() {
+  std::array<std::unique_ptr<Solver>, 2> engines;
+  for (size_t i = 0; i < engines.size(); i++) {
+    engines.at(i) = std::make_unique<Solver>(settings.engines.at(i).config);
+    engines.at(i)->SetBookSource(books);
+  }
+
+  std::array<EngineStats, 2> worker_stats;
+  for (int n = next_game++; n < settings.games; n = next_game++) {
+    PlayGame(game_order.at(n), {engines[0].get(), engines[1].get()},
+             worker_stats);
+  }
+  for (size_t i = 0; i < engines.size(); i++) {
+    worker_stats.at(i).nodes = engines.at(i)->GetNodeCount();
+  }
+
+  const std::lock_guard<std::mutex> lock(stats_mutex);
+  for (size_t i = 0; i < stats.size(); i++) {
+    stats.at(i).Merge(worker_stats.at(i));
+  }
+}
+
+bool Arena::RandomMove(const Position &pos, std::mt19937 &gen,
+                       int &move) const {
+  const uint64_t random_moves =
+      pos.CanWinNext() ? 0 : pos.PossibleNonLosingMoves();
+  if (pos.NumMoves() >= settings.random_plies || random_moves == 0) {
+    return false;
+  }
+  std::vector<int> cols;
+  for (int col = 0; col < Position::WIDTH; col++) {
+    if ((random_moves & Position::ColumnMask(col)) != 0) {
+      cols.push_back(col);
+    }
+  }
+  std::uniform_int_distribution<size_t> dist(0, cols.size() - 1);
+  move = cols.at(dist(gen));
+  return true;
+}
+
+Position Arena::OpeningPosition(const int game) const {
+  std::mt19937 gen(settings.seed + game);
+  Position pos;
+  int move = 0;
+  while (RandomMove(pos, gen, move)) {
+    pos.PlayCol(move);
+  }
+  return pos;
+}
+
+void Arena::PlayGame(const int game, const std::array<Solver *, 2> solvers,
+                     std::array<EngineStats, 2> &game_stats) const {
+  using cl = std::chrono::high_resolution_clock;
+  std::mt19937 gen(settings.seed + game);
+
+  // engines swap colors every game: engine game % 2 plays first
+  const int first = game % 2;
+  Position pos;
+  int winner = -1;
+  while (pos.NumMoves() < Position::WIDTH * Position::HEIGHT) {
+    const int engine = (first + pos.NumMoves()) % 2;
+
+    int move = 0;
+    if (!RandomMove(pos, gen, move)) {
+      const EngineSettings &engine_settings = settings.engines.at(engine);
+      Solver &solver = *solvers.at(engine);
+      const auto start = cl::now();
+      move = engine_settings.HasBudget()
+                 ? solver.FindBestMove(pos, engine_settings.limits)
+                 : solver.FindBestMove(pos);
+      const auto end = cl::now();
+      const std::chrono::duration<double, std::milli> time_taken = end - start;
+      game_stats.at(engine).AddMove(time_taken.count());
+      if (engine_settings.HasBudget() && solver.WasStopped()) {
+        game_stats.at(engine).stopped_moves++;
+      }
+    }
+
+    if (pos.IsWinningMove(move)) {
+      winner = engine;
+      break;
+    }
+    pos.PlayCol(move);
+  }
+
+  for (int engine = 0; engine < 2; engine++) {
+    const int color = engine == first ? 0 : 1;
+    Outcome outcome = kDraw;
+    if (winner != -1) {
+      outcome = winner == engine ? kWin : kLoss;
+    }
+    game_stats.at(engine).results.at(color).at(outcome)++;
+  }
+}
+
+void Arena::PrintReport(const double time_taken) const {
+  uint64_t total_moves = 0;
+  for (const auto &engine_stats : stats) {
+    total_moves += engine_stats.moves;
+  }
+
+  std::cout << "\nPlayed " << settings.games << " games in " << std::fixed
+            << std::setprecision(2) << time_taken << " seconds, "
+            << std::setprecision(1)
+            << static_cast<double>(total_moves) / time_taken
+            << " solver moves/s.\n\n";
+
+  std::cout << std::left << std::setw(8) << "engine" << std::right
+            << std::setw(20) << "first W/D/L" << std::setw(20)
+            << "second W/D/L" << std::setw(10) << "moves" << std::setw(10)
+            << "stopped" << std::setw(14)
+            << "nodes/move" << std::setw(11) << "mean ms" << std::setw(9)
+            << "p50 ms" << std::setw(9) << "p90 ms" << std::setw(9)
+            << "p99 ms" << std::setw(11) << "max ms" << '\n';
+
+  for (size_t i = 0; i < stats.size(); i++) {
+    const EngineStats &engine_stats = stats.at(i);
+    std::array<std::string, 2> results;
+    for (size_t color = 0; color < results.size(); color++) {
+      const auto &r = engine_stats.results.at(color);
+      results.at(color) = std::to_string(r[kWin]) + "/" +
+                          std::to_string(r[kDraw]) + "/" +
+                          std::to_string(r[kLoss]);
+    }
+    const auto moves = static_cast<double>(std::max<uint64_t>(1, engine_stats.moves));
+    std::cout << std::left << std::setw(8) << static_cast<char>('A' + i)
+              << std::right << std::setw(20) << results[0] << std::setw(20)
+              << results[1] << std::setw(10) << engine_stats.moves
+              << std::setw(10) << engine_stats.stopped_moves << std::setw(14) << std::setprecision(0)
+              << static_cast<double>(engine_stats.nodes) / moves
+              << std::setw(11) << std::setprecision(3)
+              << engine_stats.time_ms / moves << std::setw(9)
+              << engine_stats.Percentile(0.5) << std::setw(9)
+              << engine_stats.Percentile(0.9) << std::setw(9)
+              << engine_stats.Percentile(0.99) << std::setw(11)
+              << engine_stats.max_ms << '\n';
+  }
+
+  std::cout << "\nMove latency histogram:\n"
+            << std::setw(12) << "below" << std::setw(12) << "A"
+            << std::setw(12) << "B" << '\n';
+  int last_bucket = 0;
+  for (int b = 0; b < LATENCY_BUCKETS; b++) {
+    if (stats[0].latency.at(b) != 0 || stats[1].latency.at(b) != 0) {
+      last_bucket = b;
+    }
+  }
+  for (int b = 0; b <= last_bucket; b++) {
+    const auto limit_us = UINT64_C(2) << b;
+    const std::string limit = limit_us < 1000
+                                  ? std::to_string(limit_us) + " us"
+                                  : std::to_string(limit_us / 1000) + " ms";
+    std::cout << std::setw(12) << limit << std::setw(12)
+              << stats[0].latency.at(b) << std::setw(12)
+              << stats[1].latency.at(b) << '\n';
+  }
+}
+}  // namespace cli
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "core/book_source.hpp"
+#include "core/position.hpp"
+#include "core/solver.hpp"
+
+namespace cli {
+struct EngineSettings {
+  std::string description;
+  SolverConfig config;
+  // budget of every move, the engine plays the best move proven so far when
+  // it runs out
+  SearchLimits limits;
+
+  bool HasBudget() const {
+    return limits.max_nodes != 0 || limits.max_time.count() != 0;
+  }
+};
+
+// Parse an engine description made of comma separated settings, for example
+// "table=1048583,endgame=10,weak,budget=50". An empty description is the
+// default solver.
+bool ParseEngineSettings(const std::string &description,
+                         EngineSettings &engine);
+
+struct ArenaSettings {
+  int games = 100;
+  unsigned int threads = 1;
+  // number of random non-losing moves opening every game, so that games do
+  // not all follow the same line
+  int random_plies = 4;
+  uint32_t seed = 1;
+  std::array<EngineSettings, 2> engines;
+};
+
+/**
+ * Plays many bot versus bot games on several threads, without printing the
+ * games, to measure the solver throughput and compare two engine
+ * configurations. Every thread owns one solver per engine, engines swap
+ * colors every game and game i always starts with the same random moves for
+ * a given seed. Games are started from the one whose opening position is
+ * predicted to be the slowest to solve, so that no thread is left finishing
+ * a long game alone.
+ */
+class Arena {
+ public:
+  // every solver of every thread reads the books of book_source
+  Arena(std::shared_ptr<BookSource> book_source,
+        const ArenaSettings &arena_settings)
+      : books(std::move(book_source)), settings(arena_settings) {}
+
+  void Run();
+
+ private:
+  // move latencies are counted in buckets of powers of 2 microseconds
+  static constexpr int LATENCY_BUCKETS = 32;
+
+  enum Outcome { kWin, kDraw, kLoss };
+
+  struct EngineStats {
+    // indexed by [0: first player, 1: second player][Outcome]
+    std::array<std::array<uint64_t, 3>, 2> results{};
+    uint64_t moves = 0;
+    uint64_t stopped_moves = 0;  // moves played when the budget ran out
+    uint64_t nodes = 0;
+    double time_ms = 0;
+    double max_ms = 0;
+    std::array<uint64_t, LATENCY_BUCKETS> latency{};
+
+    void AddMove(double time_taken);
+    void Merge(const EngineStats &other);
+    double Percentile(double fraction) const;
+  };
+
+  std::shared_ptr<BookSource> books;
+  ArenaSettings settings;
+
+  // games in the order they are started
+  std::vector<int> game_order;
+  std::atomic<int> next_game{0};
+  std::mutex stats_mutex;
+  std::array<EngineStats, 2> stats;
+
+  void RunWorker();
+
+  // Pick in move the random move opening game pos, returns false once the
+  // engines play
+  bool RandomMove(const Position &pos, std::mt19937 &gen, int &move) const;
+
+  // position of game once its random opening moves are played
+  Position OpeningPosition(int game) const;
+
+  void PlayGame(int game, std::array<Solver *, 2> solvers,
+                std::array<EngineStats, 2> &game_stats) const;
+
+  void PrintReport(double time_taken) const;
+};
+}  // namespace cli
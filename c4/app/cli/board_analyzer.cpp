@@ -1,19 +1,27 @@
 #include "board_analyzer.hpp"
 
 #include <algorithm>
+#include <array>
 #include <chrono>
+#include <iomanip>
 #include <iostream>
+#include <memory>
 #include <ratio>
 #include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include "core/profiler.hpp"
 #include "core/solver.hpp"
 
 namespace cli {
 using std::max_element;
 
-BoardAnalyzer::BoardAnalyzer(const std::string &ob_path,
-                             const std::string &wb_path) {
-  solver.GetReady(ob_path, wb_path);
+BoardAnalyzer::BoardAnalyzer(std::shared_ptr<BookSource> books,
+                             const SolverConfig &config)
+    : solver(config) {
+  solver.SetBookSource(std::move(books));
 }
 
 void BoardAnalyzer::Run() {
@@ -23,12 +31,104 @@ void BoardAnalyzer::Run() {
   }
 }
 
+void BoardAnalyzer::RunGameAnalysis(const bool compare) {
+  std::string line;
+  while (std::cout << "\nEnter a game: ", std::getline(std::cin, line)) {
+    AnalyzeGame(line, compare);
+  }
+}
+
+void BoardAnalyzer::AnalyzeGame(const std::string &sequence,
+                                const bool compare) {
+  // check the moves before solving anything, the game may end with the
+  // winning move Position::Play refuses
+  Position pos;
+  const unsigned int valid = pos.Play(sequence);
+  const int last_col = valid < sequence.size() ? sequence[valid] - '1' : -1;
+  if (valid != sequence.size() &&
+      (valid + 1 != sequence.size() || last_col < 0 ||
+       last_col >= Position::WIDTH || !pos.CanPlay(last_col))) {
+    std::cout << "Invalid move " << valid + 1 << ": " << sequence << '\n';
+    return;
+  }
+
+  if (compare) {
+    solver.Reset();  // the sweep starts from an empty table too
+  }
+  const GameAnalysis analysis = solver.AnalyzeGame(sequence);
+
+  std::cout << "Game: " << sequence << '\n';
+  PrintBoard(sequence);
+  std::cout << std::setw(6) << "ply" << std::setw(6) << "move" << std::setw(7)
+            << "best" << std::setw(9) << "played" << '\n';
+  std::vector<size_t> blunders;
+  for (size_t k = 0; k < analysis.plies.size(); k++) {
+    const PlyAnalysis &ply = analysis.plies[k];
+    std::cout << std::setw(6) << k + 1 << std::setw(6) << ply.column + 1
+              << std::setw(7) << ply.best_score << std::setw(9)
+              << ply.played_score;
+    if (ply.quality == MoveQuality::kBlunder) {
+      std::cout << "  blunder";
+      blunders.push_back(k);
+    } else if (ply.quality == MoveQuality::kInaccuracy) {
+      std::cout << "  inaccuracy";
+    }
+    std::cout << '\n';
+  }
+
+  std::cout << "Scores:";
+  for (const PlyAnalysis &ply : analysis.plies) {
+    std::cout << ' ' << ply.best_score;
+  }
+  std::cout << "\nBlunders:";
+  for (const size_t k : blunders) {
+    std::cout << " ply " << k + 1 << " (" << (k % 2 == 0 ? 'x' : 'o') << ')';
+  }
+  if (blunders.empty()) {
+    std::cout << " none";
+  }
+  std::cout << ".\nAnalyzed " << analysis.plies.size() << " moves in "
+            << analysis.time_ms << " ms, " << analysis.nodes << " nodes.\n";
+
+  if (compare) {
+    const double independent_ms =
+        SolveIndependently(sequence, analysis.plies.size());
+    std::cout << "Solving every position on its own: " << independent_ms
+              << " ms, the reverse sweep saved "
+              << independent_ms - analysis.time_ms << " ms ("
+              << 100 * (independent_ms - analysis.time_ms) /
+                     std::max(independent_ms, 1e-9)
+              << "%).\n";
+  }
+  if (show_details) {
+    PrintSharedTableStats();
+  }
+}
+
+double BoardAnalyzer::SolveIndependently(const std::string &sequence,
+                                         const size_t moves) {
+  const auto start = std::chrono::steady_clock::now();
+  for (size_t k = 0; k <= moves; k++) {
+    Position pos;
+    // the prefix holding a final winning move is not a position to solve
+    if (pos.Play(std::string_view(sequence).substr(0, k)) == k &&
+        pos.NumMoves() < Position::WIDTH * Position::HEIGHT) {
+      solver.Reset();
+      solver.Solve(pos);
+    }
+  }
+  const std::chrono::duration<double, std::milli> time_taken =
+      std::chrono::steady_clock::now() - start;
+  return time_taken.count();
+}
+
 void BoardAnalyzer::FindBestMove(const std::string &sequence) {
   using cl = std::chrono::high_resolution_clock;
   Position pos;
   if (pos.Play(sequence) != sequence.size()) {
     std::cout << "Invalid move: " << sequence << '\n';
   } else {
+    C4_PROFILE_RESET();
     auto start = cl::now();
     const int score = solver.Solve(pos);
     const int best_move = solver.FindBestMove(pos);
@@ -37,6 +137,11 @@ void BoardAnalyzer::FindBestMove(const std::string &sequence) {
 
     Log(best_move, score, pos.NumMoves(), solver.GetNodeCount(),
         duration.count(), sequence);
+    if (show_details) {
+      PrintPrincipalVariation(pos);
+      PrintSharedTableStats();
+    }
+    C4_PROFILE_REPORT(std::cout);
   }
 }
 
@@ -46,15 +151,26 @@ void BoardAnalyzer::Analyze(const std::string &sequence) {
   if (pos.Play(sequence) != sequence.size()) {
     std::cout << "Invalid move: " << sequence << '\n';
   } else {
-    auto start = cl::now();
-    const auto result = solver.ScoreColumns(pos);
+    std::cout << "Sequence: " << sequence << '\n';
+    PrintBoard(sequence);
+    std::cout.flush();
+
+    C4_PROFILE_RESET();
+    std::array<int, Position::WIDTH> result{};
+    const auto start = cl::now();
+    // columns are printed as soon as they are solved, easy ones first
+    solver.ScoreColumns(pos, [&](const int col, const int score) {
+      const std::chrono::duration<double, std::milli> elapsed =
+          cl::now() - start;
+      result.at(col) = score;
+      std::cout << "Column " << col + 1 << ": " << score << " (" << elapsed.count()
+                << " ms)" << std::endl;
+    });
     auto end = cl::now();
     std::chrono::duration<double, std::milli> time_taken = end - start;
 
     auto best_move = std::max_element(result.begin(), result.end()) - result.begin();
 
-    std::cout << "Sequence: " << sequence << '\n';
-    PrintBoard(sequence);
     std::cout << "Scores: ";
     for (const int i : result) {
       std::cout << i << " ";
@@ -62,6 +178,11 @@ void BoardAnalyzer::Analyze(const std::string &sequence) {
     std::cout << "\nBest move: column " << best_move + 1 << ".\n";
     std::cout << "Nodes explored: " << solver.GetNodeCount() << ".\n";
     std::cout << "Time taken: " << time_taken.count() << " ms.\n";
+    if (show_details) {
+      PrintPrincipalVariation(pos);
+      PrintSharedTableStats();
+    }
+    C4_PROFILE_REPORT(std::cout);
   }
 }
 
@@ -74,15 +195,42 @@ void BoardAnalyzer::Log(const int best_move, const int score,
             << ", Best move: column " << best_move + 1 << '\n';
 }
 
+void BoardAnalyzer::PrintPrincipalVariation(const Position &pos) {
+  std::cout << "Principal variation:";
+  for (const int col : solver.PrincipalVariation(pos)) {
+    std::cout << ' ' << col + 1;
+  }
+  std::cout << '\n';
+}
+
+void BoardAnalyzer::PrintSharedTableStats() const {
+  const SharedMemoryTable *table =
+      solver.GetTranspositionTable().GetSharedTable();
+  if (table == nullptr) {
+    return;
+  }
+  const auto &stats = table->GetLocalStats();
+  const uint64_t lookups = stats.hits + stats.misses;
+  std::cout << "Shared table " << table->GetName() << ": "
+            << table->GetAttachedCount() << " processes attached, " << stats.hits
+            << " hits (" << stats.cross_process_hits
+            << " from other processes) out of " << lookups << " lookups";
+  if (lookups != 0) {
+    std::cout << ", cross-process hit rate "
+              << 100.0 * static_cast<double>(stats.cross_process_hits) /
+                     static_cast<double>(lookups)
+              << "%";
+  }
+  std::cout << ".\n";
+}
+
 void BoardAnalyzer::PrintBoard(const std::string &sequence) {
   constexpr int ROWS = Position::HEIGHT;
   constexpr int COLS = Position::WIDTH;
-  std::vector board(ROWS, std::vector<char>(COLS, 0));
+  std::array<std::array<char, COLS>, ROWS> board{};
 
   for (auto &row : board) {
-    for (char &col : row) {
-      col = '.';
-    }
+    row.fill('.');
   }
 
   for (size_t i = 0; i < sequence.size(); i++) {
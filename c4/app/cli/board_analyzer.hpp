@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cstdint>
+#include <memory>
 #include <string>
 
 #include "core/solver.hpp"
@@ -8,19 +9,39 @@
 namespace cli {
 class BoardAnalyzer {
  public:
-  BoardAnalyzer(const std::string &ob_path, const std::string &wb_path);
+  explicit BoardAnalyzer(std::shared_ptr<BookSource> books,
+                         const SolverConfig &config = {});
+
+  // also print the principal variation, which solves every position along
+  // it, and the shared table statistics after each query
+  void SetShowDetails(const bool show) { show_details = show; }
 
   void FindBestMove(const std::string &sequence);
   void Analyze(const std::string &sequence);
   void Run();
 
+  // Score every move of a game and point out its mistakes. With compare, the
+  // positions are also solved one by one on a cleared table, to report the
+  // time the reverse sweep saved.
+  void AnalyzeGame(const std::string &sequence, bool compare);
+  void RunGameAnalysis(bool compare);
+
  private:
   Solver solver;
+  bool show_details = false;
 
   static void Log(int best_move, int score, int number_of_moves,
                   uint64_t nodes_explored, double time_taken,
                   const std::string &sequence);
 
   static void PrintBoard(const std::string &sequence);
+
+  void PrintPrincipalVariation(const Position &pos);
+
+  void PrintSharedTableStats() const;
+
+  // time taken to solve the positions before each of the first moves of
+  // sequence, each on a cleared table
+  double SolveIndependently(const std::string &sequence, size_t moves);
 };
 }  // namespace cli
\ No newline at end of file
@@ -0,0 +1,60 @@
+#include "book_reloader.hpp"
+
+#include <iostream>
+#include <memory>
+#include <utility>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+namespace cli {
+BookReloader::BookReloader(std::shared_ptr<BookSource> book_source)
+    : books(std::move(book_source)) {
+#ifndef _WIN32
+  sigset_t hangup;
+  sigemptyset(&hangup);
+  sigaddset(&hangup, SIGHUP);
+  // threads started from now on inherit the mask
+  pthread_sigmask(SIG_BLOCK, &hangup, &previous_mask);
+  watcher = std::thread(&BookReloader::Watch, this);
+#endif
+}
+
+BookReloader::~BookReloader() {
+#ifndef _WIN32
+  stopping = true;
+  pthread_kill(watcher.native_handle(), SIGHUP);
+  watcher.join();
+  // a later hangup terminates the process again
+  pthread_sigmask(SIG_SETMASK, &previous_mask, nullptr);
+#endif
+}
+
+void BookReloader::Watch() {
+#ifndef _WIN32
+  sigset_t hangup;
+  sigemptyset(&hangup);
+  sigaddset(&hangup, SIGHUP);
+  int signal = 0;
+  while (sigwait(&hangup, &signal) == 0 && !stopping) {
+    if (!books->Reload(&BookReloader::PrintReport)) {
+      std::cerr << "\nBooks are already reloading.\n";
+    }
+  }
+#endif
+}
+
+void BookReloader::PrintReport(const BookReloadReport &report) {
+  if (!report.loaded) {
+    std::cerr << "\nBook reload failed, keeping the previous books: "
+              << report.error << '\n';
+    return;
+  }
+  std::cerr << "\nBooks reloaded in " << report.load_seconds << " seconds: "
+            << report.old_size << " -> " << report.new_size
+            << " positions, " << report.delta.added << " added, "
+            << report.delta.removed << " removed, " << report.delta.changed
+            << " changed.\n";
+}
+}  // namespace cli
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+#include "core/book_source.hpp"
+
+namespace cli {
+/**
+ * Reloads the books of a long running session when the process receives
+ * SIGHUP, then prints how the books changed. Construct it in the main thread
+ * before starting any other thread: it blocks SIGHUP there so that only its
+ * watcher thread receives the signal, and restores the previous signal mask
+ * when destroyed, so destroy it in the same thread. Does nothing on Windows.
+ */
+class BookReloader {
+ public:
+  explicit BookReloader(std::shared_ptr<BookSource> book_source);
+  ~BookReloader();
+
+  BookReloader(const BookReloader &) = delete;
+  BookReloader &operator=(const BookReloader &) = delete;
+
+ private:
+  std::shared_ptr<BookSource> books;
+  std::atomic<bool> stopping{false};
+  std::thread watcher;
+#ifndef _WIN32
+  sigset_t previous_mask;
+#endif
+
+  void Watch();
+
+  static void PrintReport(const BookReloadReport &report);
+};
+}  // namespace cli
@@ -3,13 +3,16 @@
 #include <chrono>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <string>
 #include <unordered_set>
+#include <utility>
 #include <vector>
 
 namespace cli {
-Game::Game(const std::string &ob_book, const std::string &wb_book) {
-  solver.GetReady(ob_book, wb_book);
+Game::Game(std::shared_ptr<BookSource> books, const SolverConfig &config)
+    : solver(config) {
+  solver.SetBookSource(std::move(books));
 }
 
 void Game::printConnectFourBoard(const std::string &sequence) {
@@ -213,7 +216,7 @@ void Game::StartTraining() {
           next_pos.PlayCol(col);
           uint64_t key = next_pos.Key3();
           uint8_t score = solver.Solve(next_pos) - Position::MIN_SCORE + 1;
-          solver.GetTranspositionTable().PutOpeningMove(key, score);
+          solver.AddKnownScore(key, score);
         }
       }
     }
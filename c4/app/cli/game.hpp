@@ -1,5 +1,6 @@
 #pragma once
 
+#include <memory>
 #include <string>
 
 #include "core/solver.hpp"
@@ -7,7 +8,8 @@
 namespace cli {
 class Game {
  public:
-  explicit Game(const std::string &ob_book, const std::string &wb_book);
+  explicit Game(std::shared_ptr<BookSource> books,
+                const SolverConfig &config = {});
 
   void StartPlayerVsBotGame();
 
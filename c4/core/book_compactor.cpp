@@ -0,0 +1,185 @@
+#include "book_compactor.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <unistd.h>
+#endif
+
+#include "opening_book.hpp"
+
+namespace {
+// Exclusive lock on path + ".lock" for the lifetime of the object, nothing
+// on platforms without flock
+class BookLock {
+ public:
+  explicit BookLock(const std::string &book_path) {
+#ifndef _WIN32
+    fd = open((book_path + ".lock").c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd >= 0) {
+      flock(fd, LOCK_EX);
+    }
+#else
+    (void)book_path;
+#endif
+  }
+
+  ~BookLock() {
+#ifndef _WIN32
+    if (fd >= 0) {
+      close(fd);  // releases the lock
+    }
+#endif
+  }
+
+  BookLock(const BookLock &) = delete;
+  BookLock &operator=(const BookLock &) = delete;
+
+ private:
+  int fd = -1;
+};
+
+bool fileExists(const std::string &path) {
+  return static_cast<bool>(std::ifstream(path));
+}
+}  // namespace
+
+CompactionReport CompactLogs(const std::vector<std::string> &log_paths,
+                             const std::string &book_path,
+                             const uint64_t min_nodes) {
+  const auto start = std::chrono::steady_clock::now();
+  CompactionReport report;
+
+  std::vector<SolvedRecord> log_records;
+  for (const std::string &log_path : log_paths) {
+    if (!SolvedLog::Read(log_path, log_records)) {
+      report.error = "cannot read " + log_path;
+      return report;
+    }
+  }
+  report.log_records = log_records.size();
+
+  const BookLock lock(book_path);
+  std::vector<OpeningBook::Record> book_records;
+  if (fileExists(book_path) &&
+      !OpeningBook::ReadFile(book_path, book_records)) {
+    report.error = "cannot read " + book_path;
+    return report;
+  }
+
+  auto by_key = [](const auto &a, const auto &b) { return a.key < b.key; };
+  std::stable_sort(book_records.begin(), book_records.end(), by_key);
+  std::stable_sort(log_records.begin(), log_records.end(), by_key);
+
+  // merge the sorted logs into the sorted book, the first record of a key
+  // wins, the book coming before the logs
+  std::vector<OpeningBook::Record> merged;
+  merged.reserve(book_records.size() + log_records.size());
+  auto add = [&merged, &report](const uint64_t key, const uint8_t score,
+                                const bool from_log) {
+    if (!merged.empty() && merged.back().key == key) {
+      // duplicates within the book are dropped the way OpeningBook::Load
+      // drops them, without counting them
+      if (from_log && merged.back().score != score) {
+        report.conflicts++;
+      } else if (from_log) {
+        report.duplicates++;
+      }
+      return;
+    }
+    merged.push_back({key, score});
+    if (from_log) {
+      report.added++;
+    }
+  };
+  size_t b = 0;
+  for (const SolvedRecord &record : log_records) {
+    for (; b < book_records.size() && book_records[b].key <= record.key; b++) {
+      add(book_records[b].key, book_records[b].score, false);
+    }
+    if (record.nodes < min_nodes) {
+      report.skipped++;
+    } else {
+      add(record.key, record.score, true);
+    }
+  }
+  for (; b < book_records.size(); b++) {
+    add(book_records[b].key, book_records[b].score, false);
+  }
+
+  if (report.added != 0 && !OpeningBook::WriteFile(book_path, merged)) {
+    report.error = "cannot write " + book_path;
+    return report;
+  }
+  report.ok = true;
+  report.book_size = merged.size();
+  const std::chrono::duration<double> time_taken =
+      std::chrono::steady_clock::now() - start;
+  report.seconds = time_taken.count();
+  return report;
+}
+
+LogCompactor::LogCompactor(
+    std::shared_ptr<SolvedLog> solved_log, std::string book_path,
+    const std::chrono::seconds compaction_interval,
+    std::shared_ptr<BookSource> book_source,
+    std::function<void(const CompactionReport &)> on_compacted)
+    : log(std::move(solved_log)),
+      book(std::move(book_path)),
+      interval(compaction_interval),
+      books(std::move(book_source)),
+      on_done(std::move(on_compacted)),
+      worker(&LogCompactor::Run, this) {}
+
+LogCompactor::~LogCompactor() {
+  {
+    const std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_one();
+  worker.join();
+  CompactNow();
+}
+
+CompactionReport LogCompactor::CompactNow() {
+  const std::lock_guard<std::mutex> compaction_lock(compaction_mutex);
+  if (!log->Seal()) {
+    CompactionReport report;
+    report.error = "cannot start a new segment of " + log->GetPath();
+    return report;
+  }
+
+  SealedSegments segments(log->GetPath());
+  const CompactionReport report = CompactLogs(segments.GetPaths(), book);
+  if (report.ok) {
+    segments.Remove();
+    if (report.added != 0 && books) {
+      books->Reload();
+    }
+  }
+  if (on_done) {
+    on_done(report);
+  }
+  return report;
+}
+
+void LogCompactor::Run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!wake.wait_for(lock, interval, [this] { return stopping; })) {
+    lock.unlock();
+    CompactNow();
+    lock.lock();
+  }
+}
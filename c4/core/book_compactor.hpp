@@ -0,0 +1,78 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "book_source.hpp"
+#include "solved_log.hpp"
+
+// Outcome of CompactLogs
+struct CompactionReport {
+  bool ok = false;
+  std::string error;
+  size_t log_records = 0;
+  size_t added = 0;       // positions new to the book
+  size_t duplicates = 0;  // records of positions already in the book or log
+  // records of a position whose score disagrees with the book, the book wins
+  size_t conflicts = 0;
+  size_t skipped = 0;     // records cheaper than min_nodes
+  size_t book_size = 0;
+  double seconds = 0;
+};
+
+// Merge the records of the solved logs log_paths into the book file
+// book_path, which does not have to exist yet. Records are deduplicated,
+// those which took fewer than min_nodes nodes are dropped, and the book is
+// rewritten sorted by key, through a temporary file renamed over it.
+// Concurrent compactions of the same book wait for each other.
+CompactionReport CompactLogs(const std::vector<std::string> &log_paths,
+                             const std::string &book_path,
+                             uint64_t min_nodes = 0);
+
+/**
+ * Merges a solved log into a book every interval on a background thread:
+ * the segment the process writes is sealed, every sealed segment of the log,
+ * whichever process wrote it, is compacted into the book and removed, then
+ * the books are reloaded so that the new positions are answered at once.
+ * Segments which could not be compacted are kept and compacted again the
+ * next time.
+ */
+class LogCompactor {
+ public:
+  // books may be null, when no solver reads book_path
+  LogCompactor(std::shared_ptr<SolvedLog> solved_log, std::string book_path,
+               std::chrono::seconds interval,
+               std::shared_ptr<BookSource> books,
+               std::function<void(const CompactionReport &)> on_done = {});
+
+  // compacts a last time, so that the records of the session are kept
+  ~LogCompactor();
+
+  LogCompactor(const LogCompactor &) = delete;
+  LogCompactor &operator=(const LogCompactor &) = delete;
+
+  CompactionReport CompactNow();
+
+ private:
+  std::shared_ptr<SolvedLog> log;
+  std::string book;
+  std::chrono::seconds interval;
+  std::shared_ptr<BookSource> books;
+  std::function<void(const CompactionReport &)> on_done;
+
+  std::mutex compaction_mutex;  // one compaction at a time
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping = false;
+  std::thread worker;
+
+  void Run();
+};
@@ -0,0 +1,71 @@
+#include "book_source.hpp"
+
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+BookSource::BookSource(std::string opening_book_path,
+                       std::string warmup_book_path)
+    : opening_path(std::move(opening_book_path)),
+      warmup_path(std::move(warmup_book_path)),
+      book(OpeningBook::Load(opening_path, warmup_path)) {}
+
+BookSource::~BookSource() {
+  std::thread last;
+  {
+    const std::lock_guard<std::mutex> lock(reloader_mutex);
+    last = std::move(reloader);
+  }
+  // joined outside the lock, its on_done may still call Reload
+  if (last.joinable()) {
+    last.join();
+  }
+}
+
+bool BookSource::Reload(
+    std::function<void(const BookReloadReport &)> on_done) {
+  const std::lock_guard<std::mutex> lock(reloader_mutex);
+  // from on_done the reload is still running, and the worker cannot join
+  // itself
+  if (reloading || reloader.get_id() == std::this_thread::get_id()) {
+    return false;
+  }
+  if (reloader.joinable()) {
+    reloader.join();  // the previous reload is over
+  }
+  reloading = true;
+  reloader = std::thread([this, done = std::move(on_done)] {
+    const BookReloadReport report = ReloadNow();
+    if (done) {
+      done(report);
+    }
+    reloading = false;
+  });
+  return true;
+}
+
+BookReloadReport BookSource::ReloadNow() {
+  const std::lock_guard<std::mutex> lock(reload_mutex);
+  BookReloadReport report;
+  const auto start = std::chrono::steady_clock::now();
+  const auto fresh = OpeningBook::Load(opening_path, warmup_path, report.error);
+  const std::chrono::duration<double> load_taken =
+      std::chrono::steady_clock::now() - start;
+  report.load_seconds = load_taken.count();
+  if (!fresh) {
+    return report;
+  }
+
+  const auto old = Get();
+  report.loaded = true;
+  report.old_size = old->Size();
+  report.new_size = fresh->Size();
+  report.delta = OpeningBook::Compare(*old, *fresh);
+  std::atomic_store(&book, fresh);
+  generation.fetch_add(1, std::memory_order_release);
+  return report;
+}
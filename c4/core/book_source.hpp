@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "opening_book.hpp"
+
+// Outcome of BookSource::Reload
+struct BookReloadReport {
+  // false when a book file could not be read, the previous book stays in use
+  bool loaded = false;
+  std::string error;
+  double load_seconds = 0;
+  size_t old_size = 0;
+  size_t new_size = 0;
+  OpeningBook::Delta delta;
+};
+
+/**
+ * The opening and warmup books of a process, which can be loaded again from
+ * their files while solvers keep running. A reload builds the new book apart
+ * then swaps it in atomically: solvers pick it up at the start of their next
+ * query, queries already running finish against the book they started with,
+ * which is freed once the last of them lets it go.
+ */
+class BookSource {
+ public:
+  // Load the books once, like OpeningBook::Load
+  BookSource(std::string opening_book_path, std::string warmup_book_path);
+
+  // waits for a reload still running
+  ~BookSource();
+
+  BookSource(const BookSource &) = delete;
+  BookSource &operator=(const BookSource &) = delete;
+
+  std::shared_ptr<const OpeningBook> Get() const {
+    return std::atomic_load(&book);
+  }
+
+  // incremented every time a reload swaps in a new book
+  uint64_t GetGeneration() const {
+    return generation.load(std::memory_order_acquire);
+  }
+
+  // Reload the books on a background thread, then hand the outcome to
+  // on_done on that thread. Returns false, doing nothing, when a reload is
+  // already running, which includes calls made from on_done.
+  bool Reload(std::function<void(const BookReloadReport &)> on_done = {});
+
+  // Reload the books in the calling thread
+  BookReloadReport ReloadNow();
+
+ private:
+  std::string opening_path;
+  std::string warmup_path;
+  // only accessed through std::atomic_load and std::atomic_store
+  std::shared_ptr<const OpeningBook> book;
+  std::atomic<uint64_t> generation{0};
+
+  std::mutex reload_mutex;  // one reload at a time
+  // set until on_done has returned, only set under reloader_mutex
+  std::atomic<bool> reloading{false};
+  std::mutex reloader_mutex;  // guards the reloader thread object
+  std::thread reloader;
+};
@@ -0,0 +1,161 @@
+#include "cost_model.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <string>
+#include <vector>
+
+namespace {
+// Fit pulls the weights of features the samples do not tell apart, for
+// example the book features of samples solved without a book, towards their
+// previous value instead of leaving them undetermined
+constexpr double PRIOR_WEIGHT = 1e-6;
+
+// fitted by c4_batch --calibrate without an opening book, which leaves the
+// book features at 0
+constexpr CostModel::Features DEFAULT_WEIGHTS = {
+    8.306, -0.3866, 0.02004, -1.306, 0.0832, 0.3115, 0, 0};
+
+bool childInBook(const Position &P, const OpeningBook &book) {
+  for (int col = 0; col < Position::WIDTH; col++) {
+    if (P.CanPlay(col)) {
+      Position P2(P);
+      P2.PlayCol(col);
+      if (book.Get(P2.Key3()) != 0) {
+        return true;
+      }
+    }
+  }
+  return false;
+}
+}  // namespace
+
+CostModel::CostModel() : weights(DEFAULT_WEIGHTS) {}
+
+CostModel::Features CostModel::Extract(const Position &P,
+                                       const OpeningBook *book) {
+  const double empty = Position::WIDTH * Position::HEIGHT - P.NumMoves();
+  Features features{};
+  features[0] = 1;
+  features[1] = empty;
+  features[2] = empty * empty;
+  features[3] = P.ThreatCount();
+  features[4] = P.OpponentThreatCount();
+  features[5] = __builtin_popcountll(P.PossibleNonLosingMoves());
+  if (book != nullptr && book->Size() != 0) {
+    if (childInBook(P, *book)) {
+      features[6] = 1;
+    } else {
+      for (int col = 0; col < Position::WIDTH && features[7] == 0; col++) {
+        if (P.CanPlay(col)) {
+          Position P2(P);
+          P2.PlayCol(col);
+          features[7] = childInBook(P2, *book) ? 1 : 0;
+        }
+      }
+    }
+  }
+  return features;
+}
+
+double CostModel::Predict(const Position &P, const OpeningBook *book) const {
+  if (P.isEmpty() || P.CanWinNext() || P.PossibleNonLosingMoves() == 0 ||
+      (book != nullptr && book->Get(P.Key3()) != 0)) {
+    return 0;
+  }
+  return Predict(Extract(P, book));
+}
+
+double CostModel::Predict(const Features &features) const {
+  double log_nodes = 0;
+  for (int i = 0; i < FEATURES; i++) {
+    log_nodes += weights[i] * features[i];
+  }
+  return std::max(0.0, log_nodes);
+}
+
+bool CostModel::Fit(const std::vector<Features> &samples,
+                    const std::vector<uint64_t> &nodes) {
+  if (samples.size() != nodes.size() || samples.size() < FEATURES) {
+    return false;
+  }
+
+  // normal equations (A'A + l I) w = A'y + l w0, solved in place by Gaussian
+  // elimination on the augmented matrix
+  std::array<std::array<double, FEATURES + 1>, FEATURES> system{};
+  for (size_t s = 0; s < samples.size(); s++) {
+    const double log_nodes = std::log2(static_cast<double>(nodes[s]) + 1);
+    for (int i = 0; i < FEATURES; i++) {
+      for (int j = 0; j < FEATURES; j++) {
+        system[i][j] += samples[s][i] * samples[s][j];
+      }
+      system[i][FEATURES] += samples[s][i] * log_nodes;
+    }
+  }
+  const double prior = PRIOR_WEIGHT * static_cast<double>(samples.size());
+  for (int i = 0; i < FEATURES; i++) {
+    system[i][i] += prior;
+    system[i][FEATURES] += prior * weights[i];
+  }
+
+  for (int col = 0; col < FEATURES; col++) {
+    int pivot = col;
+    for (int row = col + 1; row < FEATURES; row++) {
+      if (std::abs(system[row][col]) > std::abs(system[pivot][col])) {
+        pivot = row;
+      }
+    }
+    if (std::abs(system[pivot][col]) < prior / 2) {
+      return false;
+    }
+    std::swap(system[col], system[pivot]);
+    for (int row = 0; row < FEATURES; row++) {
+      if (row != col) {
+        const double factor = system[row][col] / system[col][col];
+        for (int k = col; k <= FEATURES; k++) {
+          system[row][k] -= factor * system[col][k];
+        }
+      }
+    }
+  }
+  for (int i = 0; i < FEATURES; i++) {
+    weights[i] = system[i][FEATURES] / system[i][i];
+  }
+  return true;
+}
+
+bool CostModel::Load(const std::string &path) {
+  std::ifstream file(path);
+  Features loaded{};
+  for (double &weight : loaded) {
+    if (!(file >> weight)) {
+      return false;
+    }
+  }
+  weights = loaded;
+  return true;
+}
+
+bool CostModel::Save(const std::string &path) const {
+  std::ofstream file(path);
+  file.precision(10);
+  for (const double weight : weights) {
+    file << weight << '\n';
+  }
+  return static_cast<bool>(file);
+}
+
+std::vector<size_t> OrderLongestFirst(const std::vector<double> &costs) {
+  std::vector<size_t> order(costs.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(),
+                   [&costs](const size_t a, const size_t b) {
+                     return costs[a] > costs[b];
+                   });
+  return order;
+}
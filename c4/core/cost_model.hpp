@@ -0,0 +1,57 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "opening_book.hpp"
+#include "position.hpp"
+
+/**
+ * Predicts how many nodes solving a position takes, so that schedulers can
+ * start the slowest positions first instead of finishing a batch with one
+ * thread grinding alone. The prediction is a linear model of the log2 of the
+ * node count over cheap position features, calibrated by least squares from
+ * the node counts of solved positions.
+ */
+class CostModel {
+ public:
+  static constexpr int FEATURES = 8;
+  using Features = std::array<double, FEATURES>;
+
+  // features, in order: constant 1, empty cells, empty cells squared, empty
+  // cells completing an alignment of the player to move, of the opponent,
+  // moves which do not lose at once, 1 when a child of the position is in the
+  // book, 1 when a grandchild is
+  static Features Extract(const Position &P, const OpeningBook *book);
+
+  // weights calibrated on random positions of 12 to 34 moves
+  CostModel();
+
+  // log2 of the predicted node count, 0 for positions solved without a search
+  double Predict(const Position &P, const OpeningBook *book) const;
+
+  double Predict(const Features &features) const;
+
+  // Least squares fit of log2(nodes + 1) over samples[i] and nodes[i].
+  // Returns false, keeping the weights, with fewer samples than features or
+  // when the samples do not determine the weights.
+  bool Fit(const std::vector<Features> &samples,
+           const std::vector<uint64_t> &nodes);
+
+  // text file of FEATURES weights
+  bool Load(const std::string &path);
+
+  bool Save(const std::string &path) const;
+
+  const Features &GetWeights() const { return weights; }
+
+ private:
+  Features weights;
+};
+
+// Indexes of costs from the largest cost to the smallest, equal costs keep
+// their order
+std::vector<size_t> OrderLongestFirst(const std::vector<double> &costs);
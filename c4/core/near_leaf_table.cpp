@@ -0,0 +1,48 @@
+#include "near_leaf_table.hpp"
+
+#include <cstdint>
+#include <cstring>
+
+#include "profiler.hpp"
+
+void NearLeafTable::Reset() {
+  if (!table.empty()) {
+    std::memset(table.data(), 0, table.size() * sizeof(Entry));
+  }
+}
+
+void NearLeafTable::Put(const uint64_t key, const uint8_t val,
+                        const uint8_t move) {
+  C4_PROFILE_SCOPE(kNearLeafPut);
+  if (table.empty()) {
+    return;
+  }
+  Entry &entry = table[key % table.size()];
+  stats.puts++;
+  if (val == 0) {
+    // only the move is new, keep the bound already stored for this key
+    if (entry.key == key) {
+      entry.move = move;
+    } else {
+      entry = {key, 0, move};
+    }
+    return;
+  }
+  entry = {key, val, move};
+}
+
+uint8_t NearLeafTable::Get(const uint64_t key, uint8_t &move) const {
+  C4_PROFILE_SCOPE(kNearLeafGet);
+  move = 0;
+  if (table.empty()) {
+    return 0;
+  }
+  const Entry &entry = table[key % table.size()];
+  if (entry.key != key) {
+    stats.misses++;
+    return 0;
+  }
+  stats.hits++;
+  move = entry.move;
+  return entry.val;
+}
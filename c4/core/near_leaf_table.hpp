@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "transposition_table.hpp"
+
+/**
+ * Small memoization table for the positions close to the leaves of the
+ * search. They are the bulk of the nodes but each one is cheap to search
+ * again, so they get a table small enough to stay in the CPU caches instead
+ * of missing in the large TranspositionTable and evicting the expensive
+ * shallow positions from it.
+ *
+ * The table is direct mapped and every Put replaces the slot, an entry only
+ * lives until a newer position hashes to the same slot. Same contract as
+ * TranspositionTable::Put and Get.
+ */
+class NearLeafTable {
+ public:
+  // size 0 disables the table, every Get then misses
+  explicit NearLeafTable(size_t size) : table(size) {}
+
+  bool IsEnabled() const { return !table.empty(); }
+
+  void Reset();
+
+  void Put(uint64_t key, uint8_t val, uint8_t move = 0);
+
+  uint8_t Get(uint64_t key) const {
+    uint8_t move = 0;
+    return Get(key, move);
+  }
+
+  uint8_t Get(uint64_t key, uint8_t &move) const;
+
+  void Prefetch(const uint64_t key) const {
+    if (!table.empty()) {
+      __builtin_prefetch(&table[key % table.size()]);
+    }
+  }
+
+  size_t GetSize() const { return table.size(); }
+
+  const TableStats &GetStats() const { return stats; }
+
+ private:
+  struct Entry {
+    uint64_t key;
+    uint8_t val;
+    uint8_t move;
+  };
+
+  std::vector<Entry> table;
+  mutable TableStats stats;
+};
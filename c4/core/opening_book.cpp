@@ -2,11 +2,71 @@
 
 #include <array>
 #include <cstdint>
+#include <cstdio>
 #include <cstring>
 #include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "profiler.hpp"
+
+std::shared_ptr<const OpeningBook> OpeningBook::Load(
+    const std::string &opening_book_path,
+    const std::string &warmup_book_path) {
+  C4_PROFILE_SCOPE(kBookLoad);
+  std::shared_ptr<OpeningBook> book(new OpeningBook());
+  book->LoadFile(opening_book_path);
+  book->opening_count = book->table.size();
+  book->LoadFile(warmup_book_path);
+  return book;
+}
+
+std::shared_ptr<const OpeningBook> OpeningBook::Load(
+    const std::string &opening_book_path, const std::string &warmup_book_path,
+    std::string &error) {
+  C4_PROFILE_SCOPE(kBookLoad);
+  std::shared_ptr<OpeningBook> book(new OpeningBook());
+  if (!book->LoadFile(opening_book_path)) {
+    error = "cannot read " + opening_book_path;
+    return nullptr;
+  }
+  book->opening_count = book->table.size();
+  if (!book->LoadFile(warmup_book_path)) {
+    error = "cannot read " + warmup_book_path;
+    return nullptr;
+  }
+  return book;
+}
+
+OpeningBook::Delta OpeningBook::Compare(const OpeningBook &from,
+                                        const OpeningBook &to) {
+  Delta delta;
+  for (const auto &[key, score] : to.table) {
+    const uint8_t old_score = from.Get(key);
+    if (old_score == 0) {
+      delta.added++;
+    } else if (old_score != score) {
+      delta.changed++;
+    }
+  }
+  delta.removed = from.Size() + delta.added - to.Size();
+  return delta;
+}
+
+bool OpeningBook::LoadFile(const std::string &book_file) {
+  if (book_file.empty()) {
+    return true;
+  }
+  std::ifstream binary_file(book_file, std::ios::binary | std::ios::ate);
+  if (!binary_file) {
+    return false;
+  }
+  // size the table once from the file size instead of growing it
+  const auto file_size = static_cast<size_t>(binary_file.tellg());
+  table.reserve(table.size() + file_size / RECORD_SIZE);
+  binary_file.seekg(0);
 
-void OpeningBook::load(const std::string &book_file) const {
-  std::ifstream binary_file(book_file, std::ios::binary);
   uint64_t move_key = 0;
   uint8_t score = 0;
 
@@ -18,6 +78,49 @@ void OpeningBook::load(const std::string &book_file) const {
     std::memcpy(&move_key, move_buf.data(), move_buf.size());
     std::memcpy(&score, score_buf.data(), score_buf.size());
 
-    T->PutOpeningMove(move_key, score);
+    table.emplace(move_key, score);
+  }
+  return true;
+}
+
+bool OpeningBook::ReadFile(const std::string &path,
+                           std::vector<Record> &records) {
+  std::ifstream binary_file(path, std::ios::binary | std::ios::ate);
+  if (!binary_file) {
+    return false;
+  }
+  const auto file_size = static_cast<size_t>(binary_file.tellg());
+  records.reserve(records.size() + file_size / RECORD_SIZE);
+  binary_file.seekg(0);
+
+  std::array<char, RECORD_SIZE> buffer{};
+  while (binary_file.read(buffer.data(), buffer.size())) {
+    Record record;
+    std::memcpy(&record.key, buffer.data(), sizeof(record.key));
+    std::memcpy(&record.score, buffer.data() + sizeof(record.key),
+                sizeof(record.score));
+    records.push_back(record);
+  }
+  return true;
+}
+
+bool OpeningBook::WriteFile(const std::string &path,
+                            const std::vector<Record> &records) {
+  const std::string temporary_path = path + ".tmp";
+  {
+    std::ofstream binary_file(temporary_path,
+                              std::ios::binary | std::ios::trunc);
+    std::array<char, RECORD_SIZE> buffer{};
+    for (const Record &record : records) {
+      std::memcpy(buffer.data(), &record.key, sizeof(record.key));
+      std::memcpy(buffer.data() + sizeof(record.key), &record.score,
+                  sizeof(record.score));
+      binary_file.write(buffer.data(), buffer.size());
+    }
+    if (!binary_file.flush()) {
+      std::remove(temporary_path.c_str());
+      return false;
+    }
   }
+  return std::rename(temporary_path.c_str(), path.c_str()) == 0;
 }
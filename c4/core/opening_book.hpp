@@ -1,15 +1,79 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <string>
+#include <vector>
 
-#include "transposition_table.hpp"
+#include "robin/robin_hood.h"
 
+/**
+ * Exact scores of book positions, keyed by Position::Key3 and encoded like
+ * the transposition table values (score - MIN_SCORE + 1). A book is never
+ * modified once loaded, so one instance is shared read-only by any number of
+ * solvers and threads.
+ */
 class OpeningBook {
  public:
-  explicit OpeningBook(TranspositionTable *table) : T(table) {}
+  // A book file is a sequence of records without header: the position key,
+  // then its score, in the host byte order
+  static constexpr size_t RECORD_SIZE = sizeof(uint64_t) + sizeof(uint8_t);
 
-  void load(const std::string &book_file) const;
+  struct Record {
+    uint64_t key = 0;
+    uint8_t score = 0;
+  };
+
+  // Entries in which two books differ, see Compare
+  struct Delta {
+    size_t added = 0;
+    size_t removed = 0;
+    size_t changed = 0;  // same position with another score
+  };
+
+  // Load the opening book then the warmup book, either path may be empty or
+  // missing. The first book holding a position wins.
+  static std::shared_ptr<const OpeningBook> Load(
+      const std::string &opening_book_path,
+      const std::string &warmup_book_path = "");
+
+  // Same as Load, but a path which is not empty has to be readable: returns
+  // null and fills error otherwise
+  static std::shared_ptr<const OpeningBook> Load(
+      const std::string &opening_book_path,
+      const std::string &warmup_book_path, std::string &error);
+
+  // entries going from book from to book to adds, removes and changes
+  static Delta Compare(const OpeningBook &from, const OpeningBook &to);
+
+  // Append the records of the book file path to records, false if it cannot
+  // be read
+  static bool ReadFile(const std::string &path, std::vector<Record> &records);
+
+  // Write records as the book file path. The records go to a temporary file
+  // renamed over path, so that a reader sees either the old or the new book.
+  static bool WriteFile(const std::string &path,
+                        const std::vector<Record> &records);
+
+  // score of a book position, 0 if the position is not in the book
+  uint8_t Get(const uint64_t key) const {
+    const auto entry = table.find(key);
+    return entry == table.end() ? 0 : entry->second;
+  }
+
+  size_t Size() const { return table.size(); }
+
+  size_t GetOpeningCount() const { return opening_count; }
+
+  size_t GetWarmupCount() const { return table.size() - opening_count; }
 
  private:
-  TranspositionTable *T;
+  robin_hood::unordered_flat_map<uint64_t, uint8_t> table;
+  size_t opening_count = 0;
+
+  OpeningBook() = default;
+
+  // false if book_file is not empty and cannot be read
+  bool LoadFile(const std::string &book_file);
 };
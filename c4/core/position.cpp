@@ -2,11 +2,15 @@
 
 #include <cassert>
 #include <cstdint>
-#include <string>
+#include <string_view>
 #include <vector>
 
 Position::Position(const std::vector<std::vector<int>> &board)
-    : current_position{0}, mask{0}, num_moves{0} {
+    : current_position{0},
+      mask{0},
+      num_moves{0},
+      current_threats{0},
+      opponent_threats{0} {
   for (const auto &v : board) {
     for (const int i : v) {
       if (i == 1 || i == 2) {
@@ -28,23 +32,33 @@ Position::Position(const std::vector<std::vector<int>> &board)
       }
     }
   }
+  current_threats = ComputeThreats(current_position);
+  opponent_threats = ComputeThreats(current_position ^ mask);
 }
 
 bool Position::CanPlay(const int col) const {
   return (mask & TopMask(col)) == 0;
 }
 
-void Position::Play(const uint64_t move) {
-  current_position ^= mask;
-  mask |= move;
-  num_moves++;
-}
-
 void Position::PlayCol(const int col) {
   Play((mask + BottomMaskCol(col)) & ColumnMask(col));
 }
 
-unsigned int Position::Play(const std::string &seq) {
+bool Position::IsValid(const uint64_t position, const uint64_t stones) {
+  if ((stones & ~board_mask) != 0 || (position & ~stones) != 0) {
+    return false;
+  }
+  for (int col = 0; col < WIDTH; col++) {
+    const uint64_t column = stones & ColumnMask(col);
+    if ((column & (column + BottomMaskCol(col))) != 0) {
+      return false;  // a hole below a stone
+    }
+  }
+  return CountSetBits(position) == CountSetBits(stones) / 2 &&
+         !HasAlignment(position) && !HasAlignment(position ^ stones);
+}
+
+unsigned int Position::Play(const std::string_view seq) {
   for (unsigned int i = 0; i < seq.size(); i++) {
     const int col = seq[i] - '1';
     if (col < 0 || col >= Position::WIDTH || !CanPlay(col) ||
@@ -73,7 +87,41 @@ uint64_t Position::PossibleNonLosingMoves() const {
   // avoid to play below an opponent winning spot
 }
 
-uint64_t Position::Key3() const {
+/**
+ * Score a move by the threats (empty cells completing a four) it leaves the
+ * player, knowing that when the board fills up the first player tends to
+ * get the cells of odd rows and the second player the ones of even rows:
+ * - a threat on a row of the player's parity counts double
+ * - a threat above an opponent threat of the same column is worthless, the
+ *   opponent gets the lower cell first
+ * - a threat on a cell the opponent also needs counts one more
+ * - each opponent threat above one of the player's threats is blocked and
+ *   counts one
+ */
+int Position::MoveScoreParity(const uint64_t move,
+                              const uint64_t move_threats) const {
+  const uint64_t stones = mask | move;
+  const uint64_t own = move_threats & ~stones;
+  const uint64_t opponent = opponent_threats & ~stones;
+  // the player to move is the first player when an even number of moves
+  // were played
+  const uint64_t own_rows = num_moves % 2 == 0 ? odd_rows_mask : even_rows_mask;
+
+  const uint64_t live = own & ~CellsAbove(opponent);
+  const uint64_t blocked = opponent & CellsAbove(own);
+  return 2 * CountSetBits(live & own_rows) + CountSetBits(live & ~own_rows) +
+         CountSetBits(own & opponent) + CountSetBits(blocked);
+}
+
+uint64_t Position::CellsAbove(const uint64_t cells) {
+  uint64_t above = (cells << 1) & board_mask;
+  for (int i = 1; i < HEIGHT - 1; i++) {
+    above |= (above << 1) & board_mask;
+  }
+  return above;
+}
+
+uint64_t Position::Key3(bool &mirrored) const {
   uint64_t key_forward = 0;
   for (int i = 0; i < Position::WIDTH; i++) {
     PartialKey3(key_forward, i);  // compute key in increasing order of columns
@@ -84,12 +132,12 @@ uint64_t Position::Key3() const {
     PartialKey3(key_reverse, i);  // compute key in decreasing order of columns
   }
 
-  return key_forward < key_reverse ? key_forward / 3 : key_reverse / 3;
+  mirrored = key_reverse < key_forward;
+  return mirrored ? key_reverse / 3 : key_forward / 3;
   // take the smallest key and divide per 3 as the last base3 digit is always 0
 }
 
-uint64_t Position::ComputeWinningPosition(const uint64_t position,
-                                          const uint64_t mask) {
+uint64_t Position::ComputeThreats(const uint64_t position) {
   // vertical;
   uint64_t result = (position << 1) & (position << 2) & (position << 3);
 
@@ -118,5 +166,5 @@ uint64_t Position::ComputeWinningPosition(const uint64_t position,
   result |= temp_pos & (position << (HEIGHT + 2));
   result |= temp_pos & (position >> 3 * (HEIGHT + 2));
 
-  return result & (board_mask ^ mask);
+  return result & board_mask;
 }
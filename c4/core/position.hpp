@@ -3,7 +3,7 @@
 #include <cassert>
 #include <climits>
 #include <cstdint>
-#include <string>
+#include <string_view>
 #include <vector>
 
 constexpr static uint64_t Bottom(const int width, const int height) {
@@ -41,22 +41,62 @@ class Position {
                     static_cast<int>(sizeof(uint64_t) * CHAR_BIT),
                 "Board does not fit in 64bits bitboard");
 
-  Position() : current_position{0}, mask{0}, num_moves{0} {}
+  Position()
+      : current_position{0},
+        mask{0},
+        num_moves{0},
+        current_threats{0},
+        opponent_threats{0} {}
 
   explicit Position(const std::vector<std::vector<int>> &board);
 
+  // build a position straight from its bitboards, see IsValid
+  Position(const uint64_t position, const uint64_t stones)
+      : current_position{position},
+        mask{stones},
+        num_moves{CountSetBits(stones)},
+        current_threats{ComputeThreats(position)},
+        opponent_threats{ComputeThreats(position ^ stones)} {}
+
+  // check that a pair of bitboards describes a reachable stone layout:
+  // stones stacked from the bottom of each column, the player to move
+  // having played exactly half of the moves (rounded down) and neither
+  // player having an alignment of 4, which would have ended the game
+  static bool IsValid(uint64_t position, uint64_t stones);
+
+  // check whether stones contain an alignment of 4
+  static bool HasAlignment(const uint64_t stones) {
+    return (ComputeThreats(stones) & stones) != 0;
+  }
+
   // return a bitmask 1 on all the cells of a given column
   static uint64_t ColumnMask(const int col) {
     return ((UINT64_C(1) << HEIGHT) - 1) << col * (HEIGHT + 1);
   }
 
+  // return the column of a move given as a single bit bitmask
+  static int MoveColumn(const uint64_t move) {
+    return __builtin_ctzll(move) / (HEIGHT + 1);
+  }
+
   bool CanPlay(int col) const;
 
-  void Play(uint64_t move);
+  void Play(const uint64_t move) { Play(move, MoveThreats(move)); }
+
+  // Same as Play(move), with the threats MoveThreats(move) already computed
+  void Play(const uint64_t move, const uint64_t move_threats) {
+    // only the alignments through move are new and they all belong to the
+    // player making the move, who becomes the opponent
+    current_threats = opponent_threats;
+    opponent_threats = move_threats;
+    current_position ^= mask;
+    mask |= move;
+    num_moves++;
+  }
 
   void PlayCol(int col);
 
-  unsigned int Play(const std::string &seq);
+  unsigned int Play(std::string_view seq);
 
   bool CanWinNext() const { return (WinningPosition() & Possible()) != 0; }
 
@@ -66,13 +106,51 @@ class Position {
 
   int NumMoves() const { return num_moves; }
 
+  // playable cells where the opponent would win at once, the player to move
+  // has to play there
+  uint64_t ForcedMoves() const {
+    return OpponentWinningPosition() & Possible();
+  }
+
   uint64_t PossibleNonLosingMoves() const;
 
+  // number of empty cells completing an alignment of 4 for the player to
+  // move, playable or not
+  int ThreatCount() const { return CountSetBits(WinningPosition()); }
+
+  int OpponentThreatCount() const {
+    return CountSetBits(OpponentWinningPosition());
+  }
+
+  // cells completing an alignment of 4 for the player to move once it played
+  // move, empty or not
+  uint64_t MoveThreats(const uint64_t move) const {
+    return ComputeThreats(current_position | move);
+  }
+
   int MoveScore(const uint64_t move) const {
-    return CountSetBits(ComputeWinningPosition(current_position | move, mask));
+    return MoveScore(move, MoveThreats(move));
+  }
+
+  int MoveScore(const uint64_t move, const uint64_t move_threats) const {
+    return CountSetBits(move_threats & ~(mask | move));
+  }
+
+  // Move ordering score aware of threat parity, see Position::MoveScoreParity
+  int MoveScoreParity(const uint64_t move) const {
+    return MoveScoreParity(move, MoveThreats(move));
   }
 
-  uint64_t Key3() const;
+  int MoveScoreParity(uint64_t move, uint64_t move_threats) const;
+
+  uint64_t Key3() const {
+    bool mirrored = false;
+    return Key3(mirrored);
+  }
+
+  // Same as Key3, mirrored tells whether the key is the one of the mirrored
+  // position, to translate columns stored along with the key
+  uint64_t Key3(bool &mirrored) const;
 
   bool isEmpty() const { return mask == 0; }
 
@@ -84,10 +162,19 @@ class Position {
   static constexpr uint64_t bottom_mask_full = Bottom(WIDTH, HEIGHT);
   static constexpr uint64_t board_mask =
       bottom_mask_full * ((1LL << HEIGHT) - 1);
+  // rows counted from 1 at the bottom, the odd rows favour the first player
+  // and the even rows the second one
+  static constexpr uint64_t odd_rows_mask =
+      bottom_mask_full * (UINT64_C(0x5555555555555555) & ((1LL << HEIGHT) - 1));
+  static constexpr uint64_t even_rows_mask = board_mask ^ odd_rows_mask;
 
   uint64_t current_position;
   uint64_t mask;
   int num_moves;
+  // cells, empty or not, completing an alignment of 4 for the player to move
+  // and for the opponent, kept up to date by Play
+  uint64_t current_threats;
+  uint64_t opponent_threats;
 
   // return a bitmask containing a single 1 corresponding to the top cell
   // of a given column
@@ -101,20 +188,24 @@ class Position {
     return UINT64_C(1) << col * (HEIGHT + 1);
   }
 
-  static uint64_t ComputeWinningPosition(uint64_t position, uint64_t mask);
+  // return a bitmask of the cells, empty or not, which complete an alignment
+  // of 4 with the stones of position
+  static uint64_t ComputeThreats(uint64_t position);
 
   static int CountSetBits(const uint64_t num) {
     return __builtin_popcountll(num);
   }
 
+  // return a bitmask of the cells strictly above a cell of cells in the same
+  // column
+  static uint64_t CellsAbove(uint64_t cells);
+
   uint64_t Possible() const { return (mask + bottom_mask_full) & board_mask; }
 
-  uint64_t WinningPosition() const {
-    return ComputeWinningPosition(current_position, mask);
-  }
+  uint64_t WinningPosition() const { return current_threats & ~mask; }
 
   uint64_t OpponentWinningPosition() const {
-    return ComputeWinningPosition(current_position ^ mask, mask);
+    return opponent_threats & ~mask;
   }
 
   void PartialKey3(uint64_t &key, const int col) const {
@@ -0,0 +1,260 @@
+#include "position_io.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "position.hpp"
+
+MappedFile::MappedFile(const std::string &path) {
+#ifndef _WIN32
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat file_stat {};
+  if (fstat(fd, &file_stat) == 0) {
+    size = static_cast<size_t>(file_stat.st_size);
+    if (size == 0) {
+      is_open = true;
+    } else {
+      void *mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (mapped != MAP_FAILED) {
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const char *>(mapped);
+        is_open = true;
+        is_mapped = true;
+      }
+    }
+  }
+  close(fd);
+#else
+  std::ifstream stream(path, std::ios::binary | std::ios::ate);
+  if (!stream) {
+    return;
+  }
+  buffer.resize(static_cast<size_t>(stream.tellg()));
+  stream.seekg(0);
+  if (stream.read(buffer.data(), static_cast<std::streamsize>(buffer.size()))) {
+    data = buffer.data();
+    size = buffer.size();
+    is_open = true;
+  }
+#endif
+}
+
+MappedFile::~MappedFile() {
+#ifndef _WIN32
+  if (is_mapped) {
+    munmap(const_cast<char *>(data), size);
+  }
+#endif
+}
+
+bool TextPositionReader::Next(Position &pos) {
+  const char *data = file.Data();
+  const size_t size = file.Size();
+
+  while (offset < size) {
+    const auto *newline = static_cast<const char *>(
+        std::memchr(data + offset, '\n', size - offset));
+    const size_t end = newline != nullptr ? newline - data : size;
+
+    std::string_view line(data + offset, end - offset);
+    offset = end + 1;
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' ')) {
+      line.remove_suffix(1);
+    }
+    if (line.empty()) {
+      continue;
+    }
+
+    pos = Position();
+    if (pos.Play(line) == line.size()) {
+      sequence = line;
+      return true;
+    }
+    invalid_count++;
+  }
+  return false;
+}
+
+BinaryPositionReader::BinaryPositionReader(const std::string &path)
+    : file(path) {
+  PositionFileHeader header;
+  if (!file.IsOpen() || file.Size() < sizeof(header)) {
+    return;
+  }
+  std::memcpy(&header, file.Data(), sizeof(header));
+
+  is_valid = header.magic == PositionFileHeader::MAGIC &&
+             header.version == PositionFileHeader::VERSION &&
+             header.width == Position::WIDTH &&
+             header.height == Position::HEIGHT &&
+             (file.Size() - sizeof(header)) / sizeof(PositionRecord) ==
+                 header.record_count &&
+             (file.Size() - sizeof(header)) % sizeof(PositionRecord) == 0;
+  if (is_valid) {
+    record_count = header.record_count;
+  }
+}
+
+bool BinaryPositionReader::Next(Position &pos) {
+  while (next_record < record_count) {
+    PositionRecord record{};
+    std::memcpy(&record,
+                file.Data() + sizeof(PositionFileHeader) +
+                    next_record * sizeof(PositionRecord),
+                sizeof(record));
+    next_record++;
+
+    if (Position::IsValid(record.current_position, record.mask)) {
+      pos = Position(record.current_position, record.mask);
+      return true;
+    }
+    invalid_count++;
+  }
+  return false;
+}
+
+BinaryPositionWriter::BinaryPositionWriter(const std::string &path)
+    : stream(path, std::ios::binary) {
+  const PositionFileHeader header;
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+}
+
+void BinaryPositionWriter::Write(const Position &pos) {
+  const PositionRecord record{pos.GetMask(), pos.GetCurrentPosition()};
+  stream.write(reinterpret_cast<const char *>(&record), sizeof(record));
+  record_count++;
+}
+
+void BinaryPositionWriter::Close() {
+  if (!stream.is_open()) {
+    return;
+  }
+  PositionFileHeader header;
+  header.record_count = record_count;
+  stream.seekp(0);
+  stream.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  stream.close();
+}
+
+void TextPositionWriter::Write(const std::string_view sequence_view) {
+  stream << sequence_view << '\n';
+}
+
+bool TextPositionWriter::Write(const Position &pos) {
+  if (!FindSequence(pos, sequence)) {
+    return false;
+  }
+  Write(std::string_view(sequence));
+  return true;
+}
+
+PositionFormat DetectPositionFormat(const std::string &path) {
+  std::ifstream stream(path, std::ios::binary);
+  if (!stream) {
+    return PositionFormat::kUnknown;
+  }
+  std::array<char, PositionFileHeader::MAGIC.size()> magic{};
+  if (stream.read(magic.data(), magic.size()) &&
+      magic == PositionFileHeader::MAGIC) {
+    return PositionFormat::kBinary;
+  }
+  return PositionFormat::kText;
+}
+
+namespace {
+// Take back the top stone of the player who moved last, in every column where
+// that is possible, until the board is empty. Dead ends are remembered so that
+// every stone layout is explored at most once.
+bool takeBack(const uint64_t current_position, const uint64_t mask,
+              std::string &reversed,
+              std::set<std::pair<uint64_t, uint64_t>> &dead_ends) {
+  if (mask == 0) {
+    return true;
+  }
+  if (dead_ends.count({current_position, mask}) != 0) {
+    return false;
+  }
+
+  const uint64_t last_player = current_position ^ mask;
+  for (int col = 0; col < Position::WIDTH; col++) {
+    const uint64_t column = mask & Position::ColumnMask(col);
+    const uint64_t top = column & ~(column >> 1);
+    if ((top & last_player) == 0) {
+      continue;
+    }
+    reversed.push_back(static_cast<char>('1' + col));
+    if (takeBack(last_player ^ top, mask ^ top, reversed, dead_ends)) {
+      return true;
+    }
+    reversed.pop_back();
+  }
+
+  dead_ends.insert({current_position, mask});
+  return false;
+}
+}  // namespace
+
+bool FindSequence(const Position &pos, std::string &sequence) {
+  const uint64_t mask = pos.GetMask();
+  const uint64_t current_position = pos.GetCurrentPosition();
+  sequence.clear();
+  if (Position::HasAlignment(current_position) ||
+      Position::HasAlignment(current_position ^ mask)) {
+    return false;  // the game would have ended before
+  }
+
+  std::set<std::pair<uint64_t, uint64_t>> dead_ends;
+  if (!takeBack(current_position, mask, sequence, dead_ends)) {
+    sequence.clear();
+    return false;
+  }
+  std::reverse(sequence.begin(), sequence.end());
+  return true;
+}
+
+bool LoadPositions(const std::string &path, std::vector<Position> &positions) {
+  Position pos;
+  switch (DetectPositionFormat(path)) {
+    case PositionFormat::kBinary: {
+      BinaryPositionReader reader(path);
+      if (!reader.IsOpen()) {
+        return false;
+      }
+      positions.reserve(positions.size() + reader.GetRecordCount());
+      while (reader.Next(pos)) {
+        positions.push_back(pos);
+      }
+      return true;
+    }
+    case PositionFormat::kText: {
+      TextPositionReader reader(path);
+      if (!reader.IsOpen()) {
+        return false;
+      }
+      while (reader.Next(pos)) {
+        positions.push_back(pos);
+      }
+      return true;
+    }
+    case PositionFormat::kUnknown:
+      break;
+  }
+  return false;
+}
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "position.hpp"
+
+/**
+ * Read-only view over the whole content of a file. The file is memory mapped
+ * where the platform supports it, so that parsing works straight on the page
+ * cache, and read into a buffer otherwise.
+ */
+class MappedFile {
+ public:
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool IsOpen() const { return is_open; }
+
+  const char *Data() const { return data; }
+
+  size_t Size() const { return size; }
+
+ private:
+  const char *data = nullptr;
+  size_t size = 0;
+  bool is_open = false;
+  bool is_mapped = false;
+  std::vector<char> buffer;
+};
+
+// Binary position files start with this header, followed by record_count
+// PositionRecords. Like the opening book, everything is stored in the host
+// byte order.
+struct PositionFileHeader {
+  static constexpr std::array<char, 4> MAGIC = {'C', '4', 'P', 'S'};
+  static constexpr uint16_t VERSION = 1;
+
+  std::array<char, 4> magic = MAGIC;
+  uint16_t version = VERSION;
+  uint8_t width = Position::WIDTH;
+  uint8_t height = Position::HEIGHT;
+  uint64_t record_count = 0;
+};
+
+struct PositionRecord {
+  uint64_t mask;
+  uint64_t current_position;
+};
+
+static_assert(sizeof(PositionFileHeader) == 16, "Unexpected header padding");
+static_assert(sizeof(PositionRecord) == 16, "Unexpected record padding");
+
+enum class PositionFormat { kUnknown, kText, kBinary };
+
+// Text files hold one move sequence per line, the same format BoardAnalyzer
+// reads from the user. Empty lines are ignored.
+class TextPositionReader {
+ public:
+  explicit TextPositionReader(const std::string &path) : file(path) {}
+
+  bool IsOpen() const { return file.IsOpen(); }
+
+  // Parse the next sequence into pos, skipping and counting the lines that
+  // are not a valid sequence. Returns false at the end of the file.
+  bool Next(Position &pos);
+
+  // Sequence of the last position returned by Next, it points into the
+  // mapped file so it stays valid as long as the reader lives
+  std::string_view GetSequence() const { return sequence; }
+
+  size_t GetInvalidCount() const { return invalid_count; }
+
+ private:
+  MappedFile file;
+  size_t offset = 0;
+  std::string_view sequence;
+  size_t invalid_count = 0;
+};
+
+class BinaryPositionReader {
+ public:
+  explicit BinaryPositionReader(const std::string &path);
+
+  // false when the file cannot be read or its header does not match its size
+  bool IsOpen() const { return is_valid; }
+
+  uint64_t GetRecordCount() const { return record_count; }
+
+  // Read the next record into pos, skipping and counting the records that do
+  // not hold a valid position. Returns false at the end of the file.
+  bool Next(Position &pos);
+
+  size_t GetInvalidCount() const { return invalid_count; }
+
+ private:
+  MappedFile file;
+  bool is_valid = false;
+  uint64_t record_count = 0;
+  uint64_t next_record = 0;
+  size_t invalid_count = 0;
+};
+
+class BinaryPositionWriter {
+ public:
+  explicit BinaryPositionWriter(const std::string &path);
+  ~BinaryPositionWriter() { Close(); }
+
+  BinaryPositionWriter(const BinaryPositionWriter &) = delete;
+  BinaryPositionWriter &operator=(const BinaryPositionWriter &) = delete;
+
+  bool IsOpen() const { return stream.is_open(); }
+
+  void Write(const Position &pos);
+
+  // Write the final record count into the header and close the file
+  void Close();
+
+ private:
+  std::ofstream stream;
+  uint64_t record_count = 0;
+};
+
+class TextPositionWriter {
+ public:
+  explicit TextPositionWriter(const std::string &path) : stream(path) {}
+
+  bool IsOpen() const { return stream.is_open(); }
+
+  void Write(std::string_view sequence);
+
+  // Write a sequence leading to pos, false if there is none
+  bool Write(const Position &pos);
+
+ private:
+  std::ofstream stream;
+  std::string sequence;
+};
+
+PositionFormat DetectPositionFormat(const std::string &path);
+
+// Find a move sequence leading to pos. Binary records do not keep the move
+// order, so this searches backwards for any order in which the stones could
+// have been played without ending the game. Returns false if there is none.
+bool FindSequence(const Position &pos, std::string &sequence);
+
+// Append every valid position of a text or binary position file
+bool LoadPositions(const std::string &path, std::vector<Position> &positions);
@@ -0,0 +1,307 @@
+#include "profiler.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <ostream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "json/json.hpp"
+
+namespace {
+constexpr size_t REGION_COUNT = static_cast<size_t>(Profiler::Region::kCount);
+
+constexpr std::array<const char *, REGION_COUNT> REGION_NAMES = {
+    "Solve",       "Negamax",     "NegamaxEndgame", "ProofNumber", "TableGet",
+    "TablePut",    "NearLeafGet", "NearLeafPut",    "BookLoad"};
+
+// Order of the hardware counters in a group read
+enum Counter { kCycles, kInstructions, kCacheMisses, kBranchMisses, kCounters };
+
+constexpr std::array<const char *, kCounters> COUNTER_NAMES = {
+    "cycles", "instructions", "llc_misses", "branch_misses"};
+
+struct Reading {
+  uint64_t time_ns = 0;
+  std::array<uint64_t, kCounters> counters{};
+};
+
+struct RegionStats {
+  uint64_t calls = 0;
+  Reading total;
+};
+
+#if defined(__linux__) && (defined(__x86_64__) || defined(__i386__))
+// Read a counter from user space with rdpmc, through the page the kernel
+// maps for its event, false when the kernel does not allow it or the event
+// is not on a hardware counter at the moment
+bool readUserCounter(const volatile perf_event_mmap_page *page,
+                     uint64_t &value) {
+  uint32_t seq = 0;
+  do {
+    seq = page->lock;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+    const uint32_t index = page->index;
+    if (page->cap_user_rdpmc == 0 || index == 0) {
+      return false;
+    }
+    // the hardware counter holds pmc_width bits, sign extended to 64
+    const unsigned shift = 64 - page->pmc_width;
+    const uint64_t pmc = __builtin_ia32_rdpmc(static_cast<int>(index - 1));
+    const int64_t count = static_cast<int64_t>(pmc << shift) >> shift;
+    value = static_cast<uint64_t>(page->offset + count);
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+  } while (page->lock != seq);
+  return true;
+}
+#elif defined(__linux__)
+bool readUserCounter(const volatile perf_event_mmap_page *, uint64_t &) {
+  return false;
+}
+#endif
+
+class ThreadProfiler {
+ public:
+  ThreadProfiler() { OpenCounters(); }
+
+  ~ThreadProfiler() {
+#ifdef __linux__
+    for (size_t i = 0; i < kCounters; i++) {
+      if (pages.at(i) != nullptr) {
+        munmap(pages.at(i), pageSize());
+      }
+      if (fds.at(i) >= 0) {
+        close(fds.at(i));
+      }
+    }
+#endif
+  }
+
+  ThreadProfiler(const ThreadProfiler &) = delete;
+  ThreadProfiler &operator=(const ThreadProfiler &) = delete;
+
+  void Enter(const Profiler::Region region) {
+    Charge();
+    if (depth < stack.size()) {
+      stack.at(depth) = region;
+    }
+    depth++;
+    stats.at(static_cast<size_t>(region)).calls++;
+  }
+
+  void Leave() {
+    Charge();
+    if (depth > 0) {
+      depth--;
+    }
+  }
+
+  void Reset() {
+    stats = {};
+    last = Read();
+  }
+
+  bool HasCounters() const { return has_counters; }
+
+  const std::array<RegionStats, REGION_COUNT> &GetStats() const {
+    return stats;
+  }
+
+ private:
+  static constexpr size_t MAX_DEPTH = 256;
+
+  std::array<int, kCounters> fds{-1, -1, -1, -1};
+  bool has_counters = false;
+#ifdef __linux__
+  // the user page of each event, for rdpmc, nullptr when it is not mapped
+  std::array<perf_event_mmap_page *, kCounters> pages{};
+
+  static size_t pageSize() {
+    return static_cast<size_t>(sysconf(_SC_PAGESIZE));
+  }
+#endif
+
+  std::array<Profiler::Region, MAX_DEPTH> stack{};
+  size_t depth = 0;
+  Reading last;
+  std::array<RegionStats, REGION_COUNT> stats{};
+
+  // charge what happened since the last event to the innermost open region
+  void Charge() {
+    const Reading now = Read();
+    if (depth > 0 && depth <= stack.size()) {
+      Reading &total = stats.at(static_cast<size_t>(stack.at(depth - 1))).total;
+      total.time_ns += now.time_ns - last.time_ns;
+      for (size_t i = 0; i < kCounters; i++) {
+        total.counters.at(i) += now.counters.at(i) - last.counters.at(i);
+      }
+    }
+    last = now;
+  }
+
+  Reading Read() const {
+    Reading reading;
+    reading.time_ns = static_cast<uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch())
+            .count());
+#ifdef __linux__
+    if (has_counters) {
+      // Enter and Leave wrap regions as short as a table probe, a read()
+      // system call would cost more than most of them: rdpmc first
+      bool user_space = true;
+      for (size_t i = 0; i < kCounters && user_space; i++) {
+        user_space = pages.at(i) != nullptr &&
+                     readUserCounter(pages.at(i), reading.counters.at(i));
+      }
+      if (user_space) {
+        return reading;
+      }
+      // PERF_FORMAT_GROUP layout: number of counters, then their values
+      std::array<uint64_t, kCounters + 1> values{};
+      if (read(fds.at(kCycles), values.data(), sizeof(values)) ==
+          static_cast<ssize_t>(sizeof(values))) {
+        for (size_t i = 0; i < kCounters; i++) {
+          reading.counters.at(i) = values.at(i + 1);
+        }
+      }
+    }
+#endif
+    return reading;
+  }
+
+  void OpenCounters() {
+#ifdef __linux__
+    constexpr std::array<uint64_t, kCounters> configs = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+        PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES};
+
+    for (size_t i = 0; i < kCounters; i++) {
+      perf_event_attr attr{};
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = configs.at(i);
+      attr.disabled = i == kCycles ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+
+      const int group = i == kCycles ? -1 : fds.at(kCycles);
+      fds.at(i) = static_cast<int>(
+          syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+      if (fds.at(i) < 0) {
+        for (int &fd : fds) {
+          if (fd >= 0) {
+            close(fd);
+          }
+          fd = -1;
+        }
+        return;  // fall back to calls and wall time only
+      }
+    }
+
+    for (size_t i = 0; i < kCounters; i++) {
+      void *page =
+          mmap(nullptr, pageSize(), PROT_READ, MAP_SHARED, fds.at(i), 0);
+      pages.at(i) = page == MAP_FAILED
+                        ? nullptr
+                        : static_cast<perf_event_mmap_page *>(page);
+    }
+    ioctl(fds.at(kCycles), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds.at(kCycles), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    has_counters = true;
+#endif
+  }
+};
+
+ThreadProfiler &threadProfiler() {
+  thread_local ThreadProfiler profiler;
+  return profiler;
+}
+}  // namespace
+
+void Profiler::Enter(const Region region) { threadProfiler().Enter(region); }
+
+void Profiler::Leave() { threadProfiler().Leave(); }
+
+void Profiler::Reset() { threadProfiler().Reset(); }
+
+bool Profiler::HasHardwareCounters() { return threadProfiler().HasCounters(); }
+
+void Profiler::PrintSummary(std::ostream &out) {
+  const ThreadProfiler &profiler = threadProfiler();
+  const auto flags = out.flags();
+  const auto precision = out.precision();
+
+  out << std::left << std::setw(16) << "region" << std::right << std::setw(12)
+      << "calls" << std::setw(12) << "time (ms)";
+  if (profiler.HasCounters()) {
+    out << std::setw(16) << "cycles" << std::setw(8) << "IPC" << std::setw(14)
+        << "LLC misses" << std::setw(14) << "br. misses";
+  }
+  out << '\n';
+
+  for (size_t i = 0; i < REGION_COUNT; i++) {
+    const RegionStats &stats = profiler.GetStats().at(i);
+    if (stats.calls == 0) {
+      continue;
+    }
+    out << std::left << std::setw(16) << REGION_NAMES.at(i) << std::right
+        << std::setw(12) << stats.calls << std::setw(12) << std::fixed
+        << std::setprecision(3)
+        << static_cast<double>(stats.total.time_ns) / 1e6;
+    if (profiler.HasCounters()) {
+      const auto &counters = stats.total.counters;
+      const double ipc =
+          counters.at(kCycles) == 0
+              ? 0
+              : static_cast<double>(counters.at(kInstructions)) /
+                    static_cast<double>(counters.at(kCycles));
+      out << std::setw(16) << counters.at(kCycles) << std::setw(8)
+          << std::setprecision(2) << ipc << std::setw(14)
+          << counters.at(kCacheMisses) << std::setw(14)
+          << counters.at(kBranchMisses);
+    }
+    out << '\n';
+  }
+  if (!profiler.HasCounters()) {
+    out << "(hardware counters unavailable, check perf_event_paranoid)\n";
+  }
+  out.flags(flags);
+  out.precision(precision);
+}
+
+void Profiler::PrintJson(std::ostream &out) {
+  const ThreadProfiler &profiler = threadProfiler();
+
+  nlohmann::json report;
+  report["hardware_counters"] = profiler.HasCounters();
+  report["regions"] = nlohmann::json::array();
+  for (size_t i = 0; i < REGION_COUNT; i++) {
+    const RegionStats &stats = profiler.GetStats().at(i);
+    if (stats.calls == 0) {
+      continue;
+    }
+    nlohmann::json region;
+    region["name"] = REGION_NAMES.at(i);
+    region["calls"] = stats.calls;
+    region["time_ns"] = stats.total.time_ns;
+    if (profiler.HasCounters()) {
+      for (size_t c = 0; c < kCounters; c++) {
+        region[COUNTER_NAMES.at(c)] = stats.total.counters.at(c);
+      }
+    }
+    report["regions"].push_back(region);
+  }
+  out << report.dump() << '\n';
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <ostream>
+
+/**
+ * Opt-in profiling of the solver hot spots, built only when configured with
+ * -DC4_PROFILING=ON. Each region records its number of calls, wall time and,
+ * where perf_event_open is permitted, CPU cycles, instructions, last level
+ * cache misses and branch misses. The counters are read in user space with
+ * rdpmc when the kernel allows it, so that entering a region costs far less
+ * than the table probes it measures. Costs are exclusive: time spent in a
+ * nested region (Negamax recursing, or probing the table) is only charged to
+ * the innermost one. Statistics are kept per thread.
+ *
+ * Use the C4_PROFILE_* macros rather than the classes, they expand to nothing
+ * when profiling is disabled.
+ */
+class Profiler {
+ public:
+  enum class Region {
+    kSolve,
+    kNegamax,
+    kNegamaxEndgame,
+    kProofNumber,
+    kTableGet,
+    kTablePut,
+    kNearLeafGet,
+    kNearLeafPut,
+    kBookLoad,
+    kCount
+  };
+
+  static void Enter(Region region);
+
+  static void Leave();
+
+  static void Reset();
+
+  // false when the kernel refused perf_event_open, only calls and time are
+  // recorded then
+  static bool HasHardwareCounters();
+
+  static void PrintSummary(std::ostream &out);
+
+  static void PrintJson(std::ostream &out);
+};
+
+class ProfileScope {
+ public:
+  explicit ProfileScope(const Profiler::Region region) {
+    Profiler::Enter(region);
+  }
+  ~ProfileScope() { Profiler::Leave(); }
+
+  ProfileScope(const ProfileScope &) = delete;
+  ProfileScope &operator=(const ProfileScope &) = delete;
+};
+
+#ifdef C4_PROFILING
+#define C4_PROFILE_SCOPE(region) \
+  const ProfileScope c4_profile_scope(Profiler::Region::region)
+#define C4_PROFILE_RESET() Profiler::Reset()
+#define C4_PROFILE_REPORT(out) \
+  (Profiler::PrintSummary(out), Profiler::PrintJson(out))
+#else
+#define C4_PROFILE_SCOPE(region)
+#define C4_PROFILE_RESET()
+#define C4_PROFILE_REPORT(out)
+#endif
@@ -0,0 +1,236 @@
+#include "shared_table.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+struct SharedMemoryTable::Header {
+  static constexpr uint64_t MAGIC = 0x43345441424c4531;  // "C4TABLE1"
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t slot_size;
+  uint64_t entry_count;
+  std::atomic<uint32_t> ready;
+  std::atomic<uint32_t> attached;
+  std::atomic<uint64_t> next_writer_id;
+  // statistics of the processes which already detached
+  std::atomic<uint64_t> hits;
+  std::atomic<uint64_t> cross_process_hits;
+  std::atomic<uint64_t> misses;
+  std::atomic<uint64_t> puts;
+};
+
+namespace {
+// the slots start on their own cache line
+constexpr size_t HEADER_SIZE = 128;
+
+// slot data: value in bits 0-7, move in bits 8-10, writer id above
+constexpr uint64_t VALUE_MASK = 0xFF;
+constexpr int MOVE_SHIFT = 8;
+constexpr uint64_t MOVE_MASK = 0x7;
+constexpr int WRITER_SHIFT = 11;
+
+// how long attaching waits for another process to finish creating the table
+constexpr int CREATION_TIMEOUT_MS = 1000;
+
+std::string segmentName(const std::string &name) {
+  return name.empty() || name[0] != '/' ? "/" + name : name;
+}
+
+std::string systemError(const std::string &call) {
+  return call + ": " + std::strerror(errno);
+}
+}  // namespace
+
+std::unique_ptr<SharedMemoryTable> SharedMemoryTable::Attach(
+    const std::string &name, const size_t entry_count, std::string &error) {
+  static_assert(sizeof(Header) <= HEADER_SIZE, "Header does not fit");
+  static_assert(std::atomic<uint64_t>::is_always_lock_free,
+                "Slots must be lock free to be shared between processes");
+#ifdef _WIN32
+  (void)name;
+  (void)entry_count;
+  error = "shared memory tables are not supported on this platform";
+  return nullptr;
+#else
+  const std::string segment = segmentName(name);
+
+  bool created = true;
+  int fd = shm_open(segment.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    created = false;
+    fd = shm_open(segment.c_str(), O_RDWR, 0600);
+  }
+  if (fd < 0) {
+    error = systemError("shm_open");
+    return nullptr;
+  }
+
+  size_t mapping_size = HEADER_SIZE + entry_count * sizeof(Slot);
+  if (created) {
+    if (ftruncate(fd, static_cast<off_t>(mapping_size)) != 0) {
+      error = systemError("ftruncate");
+      close(fd);
+      shm_unlink(segment.c_str());
+      return nullptr;
+    }
+  } else {
+    // the creator may not have sized the segment yet
+    struct stat segment_stat {};
+    for (int waited = 0;; waited++) {
+      if (fstat(fd, &segment_stat) != 0) {
+        error = systemError("fstat");
+        close(fd);
+        return nullptr;
+      }
+      if (static_cast<size_t>(segment_stat.st_size) >= HEADER_SIZE) {
+        break;
+      }
+      if (waited == CREATION_TIMEOUT_MS) {
+        error = "timed out waiting for " + segment + " to be created";
+        close(fd);
+        return nullptr;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    mapping_size = static_cast<size_t>(segment_stat.st_size);
+  }
+
+  void *mapping = mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    error = systemError("mmap");
+    if (created) {
+      shm_unlink(segment.c_str());
+    }
+    return nullptr;
+  }
+
+  auto *header = static_cast<Header *>(mapping);
+  if (created) {
+    // the segment comes zero filled, which is a valid empty table
+    new (header) Header{};
+    header->magic = Header::MAGIC;
+    header->version = LAYOUT_VERSION;
+    header->slot_size = sizeof(Slot);
+    header->entry_count = entry_count;
+    header->ready.store(1, std::memory_order_release);
+  } else {
+    for (int waited = 0;
+         header->ready.load(std::memory_order_acquire) == 0; waited++) {
+      if (waited == CREATION_TIMEOUT_MS) {
+        error = "timed out waiting for " + segment + " to be initialized";
+        munmap(mapping, mapping_size);
+        return nullptr;
+      }
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (header->magic != Header::MAGIC ||
+        header->version != LAYOUT_VERSION ||
+        header->slot_size != sizeof(Slot) ||
+        HEADER_SIZE + header->entry_count * sizeof(Slot) > mapping_size) {
+      error = segment + " was created with an incompatible layout";
+      munmap(mapping, mapping_size);
+      return nullptr;
+    }
+  }
+
+  return std::unique_ptr<SharedMemoryTable>(
+      new SharedMemoryTable(segment, mapping, mapping_size));
+#endif
+}
+
+void SharedMemoryTable::Unlink(const std::string &name) {
+#ifndef _WIN32
+  shm_unlink(segmentName(name).c_str());
+#else
+  (void)name;
+#endif
+}
+
+SharedMemoryTable::SharedMemoryTable(std::string segment, void *table_mapping,
+                                     const size_t table_mapping_size)
+    : name(std::move(segment)),
+      mapping(table_mapping),
+      mapping_size(table_mapping_size),
+      header(static_cast<Header *>(table_mapping)),
+      slots(reinterpret_cast<Slot *>(static_cast<char *>(table_mapping) +
+                                     HEADER_SIZE)),
+      entry_count(header->entry_count),
+      writer_id(header->next_writer_id.fetch_add(1) + 1) {
+  header->attached.fetch_add(1);
+}
+
+SharedMemoryTable::~SharedMemoryTable() {
+#ifndef _WIN32
+  header->hits.fetch_add(local_stats.hits);
+  header->cross_process_hits.fetch_add(local_stats.cross_process_hits);
+  header->misses.fetch_add(local_stats.misses);
+  header->puts.fetch_add(local_stats.puts);
+  header->attached.fetch_sub(1);
+  munmap(mapping, mapping_size);
+#endif
+}
+
+void SharedMemoryTable::Put(const uint64_t key, uint8_t val,
+                            const uint8_t move) {
+  Slot &slot = slots[key % entry_count];
+  if (val == 0) {
+    // only the move is new, keep the bound already stored for this key
+    const uint64_t old_data = slot.data.load(std::memory_order_relaxed);
+    if ((slot.check.load(std::memory_order_relaxed) ^ old_data) == key) {
+      val = static_cast<uint8_t>(old_data & VALUE_MASK);
+    }
+  }
+  const uint64_t data = val | (static_cast<uint64_t>(move) << MOVE_SHIFT) |
+                        (writer_id << WRITER_SHIFT);
+  slot.check.store(key ^ data, std::memory_order_relaxed);
+  slot.data.store(data, std::memory_order_relaxed);
+  local_stats.puts++;
+}
+
+uint8_t SharedMemoryTable::Get(const uint64_t key, uint8_t &move) const {
+  const Slot &slot = slots[key % entry_count];
+  move = 0;
+  const uint64_t data = slot.data.load(std::memory_order_relaxed);
+  const uint64_t check = slot.check.load(std::memory_order_relaxed);
+  if (data == 0 || (check ^ data) != key) {
+    local_stats.misses++;
+    return 0;
+  }
+  local_stats.hits++;
+  if ((data >> WRITER_SHIFT) != writer_id) {
+    local_stats.cross_process_hits++;
+  }
+  move = static_cast<uint8_t>((data >> MOVE_SHIFT) & MOVE_MASK);
+  return static_cast<uint8_t>(data & VALUE_MASK);
+}
+
+uint32_t SharedMemoryTable::GetAttachedCount() const {
+  return header->attached.load();
+}
+
+SharedMemoryTable::Stats SharedMemoryTable::GetGlobalStats() const {
+  Stats stats = local_stats;
+  stats.hits += header->hits.load();
+  stats.cross_process_hits += header->cross_process_hits.load();
+  stats.misses += header->misses.load();
+  stats.puts += header->puts.load();
+  return stats;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+/**
+ * Memoization table living in a named POSIX shared memory segment, so that
+ * every solver process on a host attached to the same name reads and writes
+ * one table instead of each re-deriving the same bounds.
+ *
+ * The table is direct mapped and every Put replaces the slot. Slots are
+ * written without locks: a slot holds data and key ^ data, a reader accepts
+ * the slot only if both words agree with the key it looks for, so a slot torn
+ * by a concurrent write simply reads as a miss.
+ */
+class SharedMemoryTable {
+ public:
+  // bump when the layout of Header or Slot changes
+  static constexpr uint32_t LAYOUT_VERSION = 2;
+
+  struct Stats {
+    uint64_t hits = 0;
+    uint64_t cross_process_hits = 0;  // hits on a value another process wrote
+    uint64_t misses = 0;
+    uint64_t puts = 0;
+  };
+
+  // Attach to the segment called name, creating it with entry_count slots if
+  // it does not exist yet. Returns null and fills error on failure, for
+  // example when the existing segment was created by an incompatible build.
+  static std::unique_ptr<SharedMemoryTable> Attach(const std::string &name,
+                                                   size_t entry_count,
+                                                   std::string &error);
+
+  // Remove the segment name, processes still attached keep their mapping
+  static void Unlink(const std::string &name);
+
+  ~SharedMemoryTable();
+
+  SharedMemoryTable(const SharedMemoryTable &) = delete;
+  SharedMemoryTable &operator=(const SharedMemoryTable &) = delete;
+
+  // same contract as TranspositionTable::Put and Get
+  void Put(uint64_t key, uint8_t val, uint8_t move);
+
+  uint8_t Get(uint64_t key, uint8_t &move) const;
+
+  void Prefetch(const uint64_t key) const {
+    __builtin_prefetch(&slots[key % entry_count]);
+  }
+
+  const std::string &GetName() const { return name; }
+
+  size_t GetEntryCount() const { return entry_count; }
+
+  // number of processes currently attached, this one included
+  uint32_t GetAttachedCount() const;
+
+  // lookups made by this process
+  const Stats &GetLocalStats() const { return local_stats; }
+
+  // lookups made by every process since the segment was created
+  Stats GetGlobalStats() const;
+
+ private:
+  struct Header;
+  struct Slot {
+    std::atomic<uint64_t> check;
+    std::atomic<uint64_t> data;
+  };
+
+  SharedMemoryTable(std::string name, void *mapping, size_t mapping_size);
+
+  std::string name;
+  void *mapping;
+  size_t mapping_size;
+  Header *header;
+  Slot *slots;
+  size_t entry_count;
+  uint64_t writer_id;
+  mutable Stats local_stats;
+};
@@ -0,0 +1,203 @@
+#include "solved_log.hpp"
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <process.h>
+#endif
+
+namespace {
+int processId() {
+#ifndef _WIN32
+  return static_cast<int>(getpid());
+#else
+  return _getpid();
+#endif
+}
+
+// "<pid>.<n>", the suffix of a segment name after the log name and a dot
+bool isSegmentSuffix(const std::string &suffix) {
+  const size_t dot = suffix.find('.');
+  auto digits = [](const std::string &s) {
+    return !s.empty() && s.find_first_not_of("0123456789") == std::string::npos;
+  };
+  return dot != std::string::npos && digits(suffix.substr(0, dot)) &&
+         digits(suffix.substr(dot + 1));
+}
+
+// Lock a sealed segment, -1 if a writer still holds it or it was removed by
+// another compactor since it was listed
+int lockSealed(const std::string &path) {
+#ifndef _WIN32
+  const int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return -1;
+  }
+  struct stat file_stat {};
+  if (flock(fd, LOCK_EX | LOCK_NB) != 0 || fstat(fd, &file_stat) != 0 ||
+      file_stat.st_nlink == 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+#else
+  return std::ifstream(path) ? 0 : -1;
+#endif
+}
+}  // namespace
+
+SolvedLog::SolvedLog(std::string log_path) : path(std::move(log_path)) {
+  OpenSegment();
+}
+
+SolvedLog::~SolvedLog() { CloseSegment(); }
+
+bool SolvedLog::OpenSegment() {
+  for (;;) {
+    segment_path = path + "." + std::to_string(processId()) + "." +
+                   std::to_string(next_segment++);
+    // "x": a segment is always a new file, never one a compactor may be
+    // taking
+    segment = std::fopen(segment_path.c_str(), "wbx");
+    if (segment == nullptr) {
+      if (errno == EEXIST) {
+        continue;
+      }
+      return false;
+    }
+#ifndef _WIN32
+    // a compactor may have taken the empty file between its creation and
+    // the lock, then the file is unlinked and another one is needed
+    struct stat file_stat {};
+    const int fd = fileno(segment);
+    if (flock(fd, LOCK_EX) != 0 || fstat(fd, &file_stat) != 0 ||
+        file_stat.st_nlink == 0) {
+      std::fclose(segment);
+      segment = nullptr;
+      continue;
+    }
+#endif
+    segment_records = 0;
+    return true;
+  }
+}
+
+void SolvedLog::CloseSegment() {
+  if (segment == nullptr) {
+    return;
+  }
+  if (segment_records == 0) {
+    std::remove(segment_path.c_str());  // still locked, nobody reads it
+  }
+  std::fclose(segment);  // releases the lock
+  segment = nullptr;
+}
+
+void SolvedLog::Append(const SolvedRecord &record) {
+  std::array<char, RECORD_SIZE> buffer{};
+  std::memcpy(buffer.data(), &record.key, sizeof(record.key));
+  std::memcpy(buffer.data() + sizeof(record.key), &record.score,
+              sizeof(record.score));
+  std::memcpy(buffer.data() + sizeof(record.key) + sizeof(record.score),
+              &record.nodes, sizeof(record.nodes));
+
+  const std::lock_guard<std::mutex> lock(mutex);
+  if (segment != nullptr &&
+      std::fwrite(buffer.data(), buffer.size(), 1, segment) == 1) {
+    std::fflush(segment);
+    segment_records++;
+  }
+}
+
+bool SolvedLog::Seal() {
+  const std::lock_guard<std::mutex> lock(mutex);
+  if (segment != nullptr && segment_records == 0) {
+    return true;  // nothing to hand over
+  }
+  CloseSegment();
+  return OpenSegment();
+}
+
+bool SolvedLog::Read(const std::string &path,
+                     std::vector<SolvedRecord> &records) {
+  std::ifstream binary_file(path, std::ios::binary | std::ios::ate);
+  if (!binary_file) {
+    return false;
+  }
+  const auto file_size = static_cast<size_t>(binary_file.tellg());
+  records.reserve(records.size() + file_size / RECORD_SIZE);
+  binary_file.seekg(0);
+
+  std::array<char, RECORD_SIZE> buffer{};
+  while (binary_file.read(buffer.data(), buffer.size())) {
+    SolvedRecord record;
+    std::memcpy(&record.key, buffer.data(), sizeof(record.key));
+    std::memcpy(&record.score, buffer.data() + sizeof(record.key),
+                sizeof(record.score));
+    std::memcpy(&record.nodes,
+                buffer.data() + sizeof(record.key) + sizeof(record.score),
+                sizeof(record.nodes));
+    records.push_back(record);
+  }
+  return true;
+}
+
+SealedSegments::SealedSegments(const std::string &log_path) {
+  namespace fs = std::filesystem;
+  std::vector<std::string> candidates;
+  std::error_code error;
+  if (fs::is_regular_file(log_path, error)) {
+    candidates.push_back(log_path);
+  }
+
+  const fs::path log(log_path);
+  const std::string prefix = log.filename().string() + ".";
+  const fs::path directory =
+      log.has_parent_path() ? log.parent_path() : fs::path(".");
+  for (fs::directory_iterator it(directory, error), end; !error && it != end;
+       it.increment(error)) {
+    const std::string name = it->path().filename().string();
+    if (name.compare(0, prefix.size(), prefix) == 0 &&
+        isSegmentSuffix(name.substr(prefix.size()))) {
+      candidates.push_back((log.parent_path() / name).string());
+    }
+  }
+
+  for (const std::string &candidate : candidates) {
+    const int fd = lockSealed(candidate);
+    if (fd >= 0) {
+      paths.push_back(candidate);
+      locks.push_back(fd);
+    }
+  }
+}
+
+SealedSegments::~SealedSegments() {
+#ifndef _WIN32
+  for (const int fd : locks) {
+    close(fd);
+  }
+#endif
+}
+
+void SealedSegments::Remove() {
+  for (const std::string &segment_path : paths) {
+    std::remove(segment_path.c_str());
+  }
+}
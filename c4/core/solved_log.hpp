@@ -0,0 +1,94 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// One exact score appended to a SolvedLog
+struct SolvedRecord {
+  uint64_t key = 0;    // Position::Key3
+  uint8_t score = 0;   // encoded like the book scores
+  uint64_t nodes = 0;  // nodes the search took
+};
+
+/**
+ * Append-only log of the exact scores solvers computed, so that they survive
+ * the process and can be merged into the book, see CompactLogs. Every
+ * SolvedLog writes its own segment files, path.<pid>.<n>, and holds an
+ * exclusive lock on the segment it writes until it seals it (Seal,
+ * destruction or a crash). Compactors only take sealed segments, see
+ * SealedSegments, so any number of processes can log to the same path
+ * without a compaction ever removing records still being appended. Every
+ * record is written with a single write and flushed to the system at once,
+ * so a crashing process loses nothing. A record torn by a crash at the end
+ * of a segment is skipped when reading.
+ */
+class SolvedLog {
+ public:
+  // key, score and nodes, in the host byte order
+  static constexpr size_t RECORD_SIZE =
+      sizeof(uint64_t) + sizeof(uint8_t) + sizeof(uint64_t);
+
+  // creates the first segment
+  explicit SolvedLog(std::string log_path);
+
+  // seals the last segment, removed if it holds no record
+  ~SolvedLog();
+
+  SolvedLog(const SolvedLog &) = delete;
+  SolvedLog &operator=(const SolvedLog &) = delete;
+
+  bool IsOpen() const { return segment != nullptr; }
+
+  const std::string &GetPath() const { return path; }
+
+  void Append(const SolvedRecord &record);
+
+  // Seal the segment written so far, if it holds records, so that compactors
+  // can take it, and start a new one. Returns false if the new segment could
+  // not be created.
+  bool Seal();
+
+  // Append the records of the log or segment file path to records, false if
+  // it cannot be read
+  static bool Read(const std::string &path, std::vector<SolvedRecord> &records);
+
+ private:
+  std::string path;
+  std::mutex mutex;
+  std::FILE *segment = nullptr;
+  std::string segment_path;
+  size_t segment_records = 0;
+  unsigned int next_segment = 0;
+
+  bool OpenSegment();
+  void CloseSegment();
+};
+
+/**
+ * The sealed segments of a log, plus the log file itself when it exists, each
+ * locked exclusively until destruction so that concurrent compactors never
+ * take the same segment. Segments still being written are left out. On
+ * Windows, which has no flock, a segment still being written can be taken
+ * too: removing it then fails, and its records are merged again later.
+ */
+class SealedSegments {
+ public:
+  explicit SealedSegments(const std::string &log_path);
+  ~SealedSegments();
+
+  SealedSegments(const SealedSegments &) = delete;
+  SealedSegments &operator=(const SealedSegments &) = delete;
+
+  const std::vector<std::string> &GetPaths() const { return paths; }
+
+  // delete the segments, once they are merged into a book
+  void Remove();
+
+ private:
+  std::vector<std::string> paths;
+  std::vector<int> locks;  // descriptors holding the segment locks
+};
@@ -1,33 +1,63 @@
 #include "solver.hpp"
 
 #include <algorithm>
+#include <array>
 #include <cassert>
 #include <chrono>
+#include <climits>
 #include <cstdint>
+#include <functional>
 #include <iostream>
-#include <map>
 #include <random>
+#include <string_view>
+#include <utility>
 #include <vector>
 
 #include "move_sorter.hpp"
 #include "position.hpp"
+#include "profiler.hpp"
+#include "trace.hpp"
+
+namespace {
+// Moves are stored in the transposition table as column + 1 of the position
+// the key was computed from, which is the mirrored one when Key3 says so
+uint8_t toStoredMove(const uint64_t move, const bool mirrored) {
+  const int col = Position::MoveColumn(move);
+  return static_cast<uint8_t>((mirrored ? Position::WIDTH - 1 - col : col) + 1);
+}
+
+int fromStoredMove(const uint8_t stored_move, const bool mirrored) {
+  return mirrored ? Position::WIDTH - stored_move : stored_move - 1;
+}
+}  // namespace
 
 /**
  * Recursively score connect 4 position using negamax & alpha-beta algorithm.
  * @param P position to calculate score
  * @param alpha, beta: alpha and beta, the window [alpha, beta] is used to
  * narrow down states whose values are within the window
+ * @param known_key key of P if the caller computed it, a zero key otherwise
  * @return the exact score, an upper or lower bound score depending on the
  * case:
  * - if actual score <= alpha then actual score <= return value <= alpha
  * - if actual score >= beta then beta <= return value <= actual score
  * - if alpha <= actual score <= beta then return value = actual score
  */
-int Solver::Negamax(const Position &P, int alpha, int beta) {
+int Solver::Negamax(const Position &P, int alpha, int beta,
+                    const PositionKey &known_key) {
+  C4_PROFILE_SCOPE(kNegamax);
   assert(alpha < beta);
   assert(!P.CanWinNext());
 
+  if (Position::WIDTH * Position::HEIGHT - P.NumMoves() <=
+      config.endgame_threshold) {
+    return NegamaxEndgame(P, alpha, beta);
+  }
+
   nodeCount++;
+  if (nodeCount >= nextStopCheck && CheckStop()) {
+    return alpha;  // the caller discards the value of a stopped search
+  }
 
   const uint64_t next = P.PossibleNonLosingMoves();
   if (next == 0) {
@@ -55,12 +85,27 @@ int Solver::Negamax(const Position &P, int alpha, int beta) {
   // max is the smallest number of moves needed for the current player to win,
   // also used to narrow down window.
   int max = (Position::WIDTH * Position::HEIGHT - 1 - P.NumMoves()) / 2;
-  if (const int val = static_cast<int>(transTable.Get(P.Key3()))) {
-    // check if the current state is in transTable or not, if it is, retrieve
-    // the value
+  bool mirrored = known_key.mirrored;
+  const uint64_t key = known_key.key != 0 ? known_key.key : P.Key3(mirrored);
+  uint8_t stored_move = 0;
+  int val = GetExactScore(key);
+  if (val == 0) {
+    val = TableGet(P, key, stored_move);
+  }
+  if (val != 0) {
+    // check if the current state is in the books or in transTable, if it
+    // is, retrieve the value
     max = val + Position::MIN_SCORE - 1;
   }
 
+  if (config.zugzwang_rules && beta > 0 && max > 0 && P.NumMoves() % 2 == 0 &&
+      ProveNoWin(P)) {
+    // the rules only prove the position is not won, remember it
+    max = 0;
+    TablePut(P, key, static_cast<uint8_t>(1 - Position::MIN_SCORE),
+             stored_move);
+  }
+
   if (beta > max) {
     beta = max;  // no need to explore nodes whose values greater than max
     if (alpha >= beta) {
@@ -69,47 +114,635 @@ int Solver::Negamax(const Position &P, int alpha, int beta) {
     // prune the exploration if the [alpha;beta] window is empty.
   }
 
+  if (config.forcing_search && beta > 0 &&
+      Position::WIDTH * Position::HEIGHT - P.NumMoves() >
+          FORCING_PROBE_MIN_EMPTY) {
+    // a short forced win is cheaper to find than to search for
+    forcingStats.probes++;
+    forcingNodesLeft = FORCING_PROBE_NODES;
+    const int length = ForcedWin(P, FORCING_PROBE_DEPTH);
+    if (length >= 0) {
+      const int score = (Position::WIDTH * Position::HEIGHT + 1 -
+                         P.NumMoves() - 2 * length) /
+                        2;
+      if (score >= beta) {
+        forcingStats.probe_cutoffs++;
+        return score;
+      }
+    }
+  }
+
+  // the move which was best or caused a cutoff the last time this position
+  // was searched is tried first, before the sorted moves
+  uint64_t hash_move = 0;
+  if (config.hash_move && stored_move != 0) {
+    hash_move =
+        next & Position::ColumnMask(fromStoredMove(stored_move, mirrored));
+  }
+
+  // threats of each move by column, computed once for sorting and handed
+  // over to the child position
+  std::array<uint64_t, Position::WIDTH> move_threats;
   MoveSorter moves;
   for (int i = Position::WIDTH; i-- != 0;) {
-    if (const uint64_t move = next & Position::ColumnMask(columnOrder.at(i))) {
-      moves.Add(move, P.MoveScore(move));
+    const int col = columnOrder.at(i);
+    const uint64_t move = next & Position::ColumnMask(col);
+    if (move == 0) {
+      continue;
+    }
+    const uint64_t threats = P.MoveThreats(move);
+    move_threats.at(col) = threats;
+    if (move != hash_move) {
+      moves.Add(move, config.move_ordering == MoveOrdering::kThreatParity
+                          ? P.MoveScoreParity(move, threats)
+                          : P.MoveScore(move, threats));
     }
   }
 
-  while (const uint64_t next_move = moves.GetNext()) {
+  // keys of the children computed by the enhanced cutoff, handed over to
+  // their search
+  std::array<PositionKey, Position::WIDTH> child_keys{};
+  if (config.enhanced_cutoffs && !IsNearLeaf(P) &&
+      Position::WIDTH * Position::HEIGHT - P.NumMoves() - 1 >
+          config.endgame_threshold) {
+    uint64_t cutoff_move = 0;
+    const int score = EnhancedCutoff(P, next, move_threats, beta,
+                                     cutoff_move, child_keys);
+    if (cutoff_move != 0) {
+      if (config.hash_move) {
+        TablePut(P, key, 0, toStoredMove(cutoff_move, mirrored));
+      }
+      return score;
+    }
+  }
+
+  uint64_t best_move = 0;
+  for (uint64_t next_move = hash_move != 0 ? hash_move : moves.GetNext();
+       next_move != 0; next_move = moves.GetNext()) {
+    const int col = Position::MoveColumn(next_move);
     Position P2(P);
-    P2.Play(next_move);
-    const int score = -Negamax(P2, -beta, -alpha);
+    P2.Play(next_move, move_threats.at(col));
+    const int score = -Negamax(P2, -beta, -alpha, child_keys.at(col));
+    if (stopped) {
+      return alpha;  // nothing is stored from an unfinished search
+    }
 
     if (score >= beta) {
+      if (config.hash_move && next_move != hash_move) {
+        // only remember the cutoff move, a lower bound is not stored
+        TablePut(P, key, 0, toStoredMove(next_move, mirrored));
+      }
       return score;  // prune the exploration
     }
-    alpha = std::max(score, alpha);  // reduce the [alpha;beta] window
+    if (score > alpha) {
+      alpha = score;  // reduce the [alpha;beta] window
+      best_move = next_move;
+    }
   }
 
   // save the upper bound of the position, minus MIN_SCORE and +1 to make
   // sure the lowest value is 1
-  transTable.Put(P.Key3(), alpha - Position::MIN_SCORE + 1);
+  TablePut(P, key, alpha - Position::MIN_SCORE + 1,
+           best_move != 0 ? toStoredMove(best_move, mirrored) : stored_move);
+  return alpha;
+}
+
+/**
+ * Enhanced transposition cutoff: look up the positions every move of P leads
+ * to before searching any of them. The upper bound stored for a child is a
+ * lower bound of the score of P through that move, so a child stored low
+ * enough proves the beta cutoff of P without a search. The table slots of
+ * all the children are prefetched first, so that their cache misses
+ * overlap instead of following each other.
+ * @return a lower bound of the score of P of at least beta, with the move
+ * reaching it in cutoff_move, or 0 with cutoff_move left at 0 when no child
+ * proves the cutoff. The keys of the children are left in child_keys, by
+ * column, so that their search does not compute them again.
+ */
+int Solver::EnhancedCutoff(
+    const Position &P, const uint64_t next,
+    const std::array<uint64_t, Position::WIDTH> &move_threats, const int beta,
+    uint64_t &cutoff_move,
+    std::array<PositionKey, Position::WIDTH> &child_keys) {
+  enhancedCutoffStats.searches++;
+  std::array<Position, Position::WIDTH> children;
+  std::array<int, Position::WIDTH> cols{};
+  int count = 0;
+  for (const int col : columnOrder) {
+    const uint64_t move = next & Position::ColumnMask(col);
+    if (move == 0) {
+      continue;
+    }
+    Position &child = children.at(count);
+    child = P;
+    child.Play(move, move_threats.at(col));
+    PositionKey &child_key = child_keys.at(col);
+    child_key.key = child.Key3(child_key.mirrored);
+    TablePrefetch(child, child_key.key);
+    cols.at(count++) = col;
+  }
+
+  for (int i = 0; i < count; i++) {
+    const uint64_t key = child_keys.at(cols.at(i)).key;
+    int val = GetExactScore(key);
+    if (val == 0) {
+      val = TableGet(children.at(i), key);
+    }
+    if (val == 0) {
+      continue;
+    }
+    const int score = -(val + Position::MIN_SCORE - 1);
+    if (score >= beta) {
+      enhancedCutoffStats.cutoffs++;
+      cutoff_move = next & Position::ColumnMask(cols.at(i));
+      return score;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Negamax variant for the last few empty cells. With so little left to
+ * explore, sorting moves and probing the transposition table costs more than
+ * it saves, so this only keeps the forced-move pruning of
+ * PossibleNonLosingMoves and the score window narrowing, and walks the
+ * remaining moves straight off the bitboard in column order. It never
+ * allocates and never touches the transposition table.
+ * Same contract as Negamax.
+ */
+int Solver::NegamaxEndgame(const Position &P, int alpha, int beta) {
+  C4_PROFILE_SCOPE(kNegamaxEndgame);
+  assert(alpha < beta);
+  assert(!P.CanWinNext());
+
+  nodeCount++;
+  if (nodeCount >= nextStopCheck && CheckStop()) {
+    return alpha;
+  }
+
+  const uint64_t next = P.PossibleNonLosingMoves();
+  if (next == 0) {
+    return -((Position::WIDTH * Position::HEIGHT) - P.NumMoves()) / 2;
+  }
+
+  if (P.NumMoves() >= Position::WIDTH * Position::HEIGHT - 2) {
+    return 0;
+  }
+
+  const int min =
+      -((Position::WIDTH * Position::HEIGHT) - 2 - P.NumMoves()) / 2;
+  if (alpha < min) {
+    alpha = min;
+    if (alpha >= beta) {
+      return alpha;
+    }
+  }
+
+  const int max = (Position::WIDTH * Position::HEIGHT - 1 - P.NumMoves()) / 2;
+  if (beta > max) {
+    beta = max;
+    if (alpha >= beta) {
+      return beta;
+    }
+  }
+
+  for (int i = 0; i < Position::WIDTH; i++) {
+    const uint64_t move = next & Position::ColumnMask(columnOrder.at(i));
+    if (move == 0) {
+      continue;
+    }
+    Position P2(P);
+    P2.Play(move);
+    const int score = -NegamaxEndgame(P2, -beta, -alpha);
+    if (stopped) {
+      return alpha;
+    }
+
+    if (score >= beta) {
+      return score;
+    }
+    alpha = std::max(score, alpha);
+  }
+
   return alpha;
 }
 
+/**
+ * Look for a win of the player to move made of moves which each threaten to
+ * win at once, so that every reply of the opponent is forced, until a move
+ * makes two threats or lands below one. Such wins are common in positions
+ * that take Negamax a wide search to prove and this finds them by following
+ * only the forcing moves, within FORCING_SEARCH_NODES nodes. The shortest
+ * forced win is searched first.
+ * On success the forcing moves are stored as hash moves and the positions
+ * they leave to the opponent get the upper bound of a loss in the
+ * transposition table, so that Negamax follows the line at once.
+ * @return the number of moves the player to move plays before the winning
+ * one, -1 if no forced win was found
+ */
+int Solver::FindForcedWin(const Position &P) {
+  forcingStats.searches++;
+  forcingNodesLeft = FORCING_SEARCH_NODES;
+  const uint64_t start_nodes = nodeCount;
+  int length = -1;
+  const int max_depth =
+      (Position::WIDTH * Position::HEIGHT - P.NumMoves()) / 2;
+  for (int depth = 1; depth <= max_depth && length < 0; depth++) {
+    forcingDepthReached = false;
+    length = ForcedWin(P, depth);
+    if (!forcingDepthReached || forcingNodesLeft == 0) {
+      break;  // a deeper search would not find more
+    }
+  }
+  if (length >= 0) {
+    forcingStats.wins++;
+  }
+  forcingStats.nodes += nodeCount - start_nodes;
+  return length;
+}
+
+// Forced win of the player to move within depth forcing moves, same result
+// as FindForcedWin
+int Solver::ForcedWin(const Position &P, const int depth) {
+  if (P.CanWinNext()) {
+    return 0;
+  }
+  if (depth == 0) {
+    forcingDepthReached = true;
+    return -1;
+  }
+  if (forcingNodesLeft == 0) {
+    return -1;
+  }
+  forcingNodesLeft--;
+  nodeCount++;
+
+  const uint64_t next = P.PossibleNonLosingMoves();
+  for (const int col : columnOrder) {
+    const uint64_t move = next & Position::ColumnMask(col);
+    if (move == 0) {
+      continue;
+    }
+    Position P2(P);
+    P2.Play(move);
+    const uint64_t forced = P2.ForcedMoves();
+    if (forced == 0) {
+      continue;  // not a threat
+    }
+    int length = 1;
+    if ((forced & (forced - 1)) == 0) {
+      // a single threat, the opponent blocks it
+      Position P3(P2);
+      P3.Play(forced);
+      const int rest = ForcedWin(P3, depth - 1);
+      if (rest < 0) {
+        continue;
+      }
+      length += rest;
+    }
+
+    // the opponent loses the game before playing length more moves
+    const int score = -(Position::WIDTH * Position::HEIGHT + 1 -
+                        P.NumMoves() - 2 * length) /
+                      2;
+    const uint64_t opponent_key = P2.Key3();
+    const auto bound =
+        static_cast<uint8_t>(score - Position::MIN_SCORE + 1);
+    const uint8_t old_bound = TableGet(P2, opponent_key);
+    if (old_bound == 0 || old_bound > bound) {
+      TablePut(P2, opponent_key, bound);
+    }
+    if (config.hash_move) {
+      bool mirrored = false;
+      const uint64_t key = P.Key3(mirrored);
+      TablePut(P, key, 0, toStoredMove(move, mirrored));
+    }
+    return length;
+  }
+  return -1;
+}
+
+/**
+ * Proof-number search of whether the score of P is above med, the question
+ * Negamax answers with the window [med, med + 1]. The tree grows one node at
+ * a time below the most proving leaf: the leaf whose proof settles the
+ * question with the fewest more leaves proven, counted by the proof and
+ * disproof numbers of the nodes. Deep and narrow wins, which Negamax has to
+ * refute every alternative of at every ply to find, take far fewer nodes.
+ * Leaves are bounded by the books and the upper bounds of the
+ * transposition table, and the bounds proven by the search are stored back
+ * into the table for Negamax and the next tests.
+ * @return 1 if the score is above med, -1 if it is not, 0 when the node
+ * pool is full or the search was stopped
+ */
+int Solver::ProofNumber(const Position &P, const int med) {
+  C4_PROFILE_SCOPE(kProofNumber);
+  constexpr int CELLS = Position::WIDTH * Position::HEIGHT;
+  if (proofNodes.empty()) {
+    proofNodes.resize(std::max<size_t>(config.proof_nodes, 1));
+  }
+  proofNumberStats.searches++;
+  const uint64_t start_nodes = nodeCount;
+  proofNodes[0] = EvaluateProofNode(P, true, med);
+  size_t used = 1;
+
+  // nodes and positions from the root to the most proving leaf, the root
+  // player moves at the even depths
+  std::array<uint32_t, CELLS + 1> path{};
+  std::array<Position, CELLS + 1> positions{P};
+  int result = 0;
+  // the path above a node whose numbers did not change still leads to the
+  // most proving leaf, so the next descent starts from that node
+  int depth = 0;
+  while (proofNodes[0].proof != 0 && proofNodes[0].disproof != 0) {
+    while (proofNodes[path[depth]].child_count != 0) {
+      const ProofNode &node = proofNodes[path[depth]];
+      const bool or_node = depth % 2 == 0;
+      uint32_t best = node.first_child;
+      for (uint32_t child = best + 1;
+           child < node.first_child + node.child_count; child++) {
+        if (or_node ? proofNodes[child].proof < proofNodes[best].proof
+                    : proofNodes[child].disproof < proofNodes[best].disproof) {
+          best = child;
+        }
+      }
+      path[depth + 1] = best;
+      positions[depth + 1] = positions[depth];
+      positions[depth + 1].PlayCol(proofNodes[best].column);
+      depth++;
+    }
+
+    const Position &leaf = positions[depth];
+    const uint64_t next = leaf.PossibleNonLosingMoves();
+    const auto child_count = static_cast<size_t>(__builtin_popcountll(next));
+    if (used + child_count > proofNodes.size()) {
+      proofNumberStats.fallbacks++;
+      break;
+    }
+    ProofNode &expanded = proofNodes[path[depth]];
+    expanded.first_child = static_cast<uint32_t>(used);
+    expanded.child_count = static_cast<uint8_t>(child_count);
+    for (const int col : columnOrder) {
+      const uint64_t move = next & Position::ColumnMask(col);
+      if (move != 0) {
+        Position child(leaf);
+        child.Play(move);
+        proofNodes[used] = EvaluateProofNode(child, depth % 2 != 0, med);
+        proofNodes[used++].column = static_cast<uint8_t>(col);
+      }
+    }
+    if (nodeCount >= nextStopCheck && CheckStop()) {
+      break;
+    }
+
+    // back up the new numbers until a node keeps its own
+    for (; depth >= 0; depth--) {
+      ProofNode &node = proofNodes[path[depth]];
+      const bool or_node = depth % 2 == 0;
+      uint32_t proof = or_node ? PROOF_INFINITY : 0;
+      uint32_t disproof = or_node ? 0 : PROOF_INFINITY;
+      for (uint32_t child = node.first_child;
+           child < node.first_child + node.child_count; child++) {
+        const ProofNode &c = proofNodes[child];
+        if (or_node) {
+          proof = std::min(proof, c.proof);
+          disproof = std::min(PROOF_INFINITY, disproof + c.disproof);
+        } else {
+          proof = std::min(PROOF_INFINITY, proof + c.proof);
+          disproof = std::min(disproof, c.disproof);
+        }
+      }
+      if (proof == node.proof && disproof == node.disproof) {
+        break;
+      }
+      node.proof = proof;
+      node.disproof = disproof;
+      if (proof == 0 || disproof == 0) {
+        StoreProofBound(positions[depth], node, or_node, med);
+      }
+    }
+    depth = std::max(depth, 0);
+  }
+
+  if (proofNodes[0].proof == 0) {
+    proofNumberStats.proofs++;
+    result = 1;
+  } else if (proofNodes[0].disproof == 0) {
+    proofNumberStats.disproofs++;
+    result = -1;
+  }
+  proofNumberStats.nodes += nodeCount - start_nodes;
+  return result;
+}
+
+// Proof and disproof numbers of a new leaf. At an or node the root player
+// is to move and the score of P has to be above med, at an and node the
+// opponent is to move and the score of P has to be below -med.
+Solver::ProofNode Solver::EvaluateProofNode(const Position &P,
+                                            const bool or_node,
+                                            const int med) {
+  constexpr int CELLS = Position::WIDTH * Position::HEIGHT;
+  nodeCount++;
+
+  // bounds of the score of P, same as Negamax
+  int min = 0;
+  int max = 0;
+  const uint64_t next = P.CanWinNext() ? 0 : P.PossibleNonLosingMoves();
+  if (P.CanWinNext()) {
+    min = max = (CELLS + 1 - P.NumMoves()) / 2;
+  } else if (next == 0) {
+    min = max = -(CELLS - P.NumMoves()) / 2;
+  } else if (P.NumMoves() < CELLS - 2) {
+    min = -(CELLS - 2 - P.NumMoves()) / 2;
+    max = (CELLS - 1 - P.NumMoves()) / 2;
+    if (CELLS - P.NumMoves() <= config.endgame_threshold) {
+      // the endgame search answers the question faster than growing the
+      // tree below P
+      const int target = or_node ? med : -med - 1;
+      const int score = NegamaxEndgame(P, target, target + 1);
+      if (score > target) {
+        min = std::max(min, score);
+      } else {
+        max = std::min(max, score);
+      }
+    } else {
+      const uint64_t key = P.Key3();
+      if (const int score = GetExactScore(key)) {
+        min = max = score + Position::MIN_SCORE - 1;
+      } else if (const int val = TableGet(P, key)) {
+        max = std::min(max, val + Position::MIN_SCORE - 1);
+      }
+    }
+  }
+
+  // the question asked of P from the point of view of its player to move
+  const bool proved = or_node ? min > med : max < -med;
+  const bool disproved = or_node ? max <= med : min >= -med;
+  ProofNode node{};
+  if (proved) {
+    node.disproof = PROOF_INFINITY;
+  } else if (disproved) {
+    node.proof = PROOF_INFINITY;
+  } else {
+    // a move proves an or node, every move has to disprove it
+    const auto moves = static_cast<uint32_t>(__builtin_popcountll(next));
+    node.proof = or_node ? 1 : moves;
+    node.disproof = or_node ? moves : 1;
+  }
+  return node;
+}
+
+// Remember what deciding a node proved about its position: an upper bound
+// of its score in the transposition table, or the move that beats med as
+// its hash move. Endgame positions are never looked up there.
+void Solver::StoreProofBound(const Position &P, const ProofNode &node,
+                             const bool or_node, const int med) {
+  constexpr int CELLS = Position::WIDTH * Position::HEIGHT;
+  if (CELLS - P.NumMoves() <= config.endgame_threshold) {
+    return;
+  }
+  bool mirrored = false;
+  const uint64_t key = P.Key3(mirrored);
+  uint8_t stored_move = 0;
+  const uint8_t old_bound = TableGet(P, key, stored_move);
+
+  // a disproved or node scores at most med, a proved and node at most
+  // -med - 1, the other outcomes come from a move scoring above the window
+  const bool upper_bound = or_node == (node.disproof == 0);
+  if (upper_bound) {
+    const int score = or_node ? med : -med - 1;
+    const int bound = score - Position::MIN_SCORE + 1;
+    if (bound >= 1 && (old_bound == 0 || old_bound > bound)) {
+      TablePut(P, key, static_cast<uint8_t>(bound), stored_move);
+    }
+  } else if (config.hash_move) {
+    for (uint32_t child = node.first_child;
+         child < node.first_child + node.child_count; child++) {
+      if ((or_node ? proofNodes[child].proof
+                   : proofNodes[child].disproof) == 0) {
+        TablePut(P, key, 0,
+                 toStoredMove(Position::ColumnMask(proofNodes[child].column),
+                              mirrored));
+        break;
+      }
+    }
+  }
+}
+
 int Solver::Solve(const Position &P) {
+  C4_PROFILE_SCOPE(kSolve);
+  QueryScope query(*this, "solve", P);
+  int score = SolveRoot(P).min;
+  if (config.weak) {
+    score = std::clamp(score, -1, 1);
+  }
+  query.Finish({score});
+  return score;
+}
+
+SolveResult Solver::Solve(const Position &P, const SearchLimits &limits) {
+  C4_PROFILE_SCOPE(kSolve);
+  QueryScope query(*this, "solve_limited", P, &limits);
+  BeginSearch(limits);
+  SolveResult result = SolveRoot(P);
+  EndSearch();
+  if (config.weak) {
+    result.min = std::clamp(result.min, -1, 1);
+    result.max = std::clamp(result.max, -1, 1);
+  }
+  query.Finish({result.min, result.max});
+  return result;
+}
+
+void Solver::BeginSearch(const SearchLimits &limits) {
+  cancelFlag = limits.cancel;
+  progressCallback = limits.on_progress ? &limits.on_progress : nullptr;
+  searchStartNodes = nodeCount;
+  nodeLimit = limits.max_nodes != 0 ? nodeCount + limits.max_nodes : UINT64_MAX;
+  hasDeadline = limits.max_time.count() != 0;
+  if (hasDeadline) {
+    deadline = std::chrono::steady_clock::now() + limits.max_time;
+  }
+  stopped = false;
+  backend = limits.backend.value_or(config.backend);
+  const bool limited = cancelFlag != nullptr || hasDeadline;
+  nextStopCheck = std::min(
+      limited ? nodeCount + STOP_CHECK_INTERVAL : UINT64_MAX, nodeLimit);
+}
+
+void Solver::EndSearch() {
+  lastSearchStopped = stopped;
+  cancelFlag = nullptr;
+  progressCallback = nullptr;
+  nodeLimit = UINT64_MAX;
+  nextStopCheck = UINT64_MAX;
+  hasDeadline = false;
+  stopped = false;
+  backend = config.backend;
+}
+
+bool Solver::CheckStop() {
+  if (stopped) {
+    return true;
+  }
+  if (nodeCount >= nodeLimit ||
+      (cancelFlag != nullptr && cancelFlag->load(std::memory_order_relaxed)) ||
+      (hasDeadline && std::chrono::steady_clock::now() >= deadline)) {
+    stopped = true;
+    nextStopCheck = 0;  // unwind without checking again
+    return true;
+  }
+  nextStopCheck = std::min(nodeCount + STOP_CHECK_INTERVAL, nodeLimit);
+  return false;
+}
+
+SolveResult Solver::SolveRoot(const Position &P, const int lower_bound) {
+  SolveResult result;
   if (P.isEmpty()) {
-    return 1;
+    result.min = result.max = 1;
+    return result;
   }
-  if (transTable.Get(P.Key3()) != 0) {
-    return static_cast<int>(transTable.Get(P.Key3())) + Position::MIN_SCORE - 1;
+  const uint64_t key = P.Key3();
+  if (const int score = GetExactScore(key)) {
+    // the books hold exact scores
+    result.min = result.max = score + Position::MIN_SCORE - 1;
+    return result;
   }
   if (P.CanWinNext()) {
     // check if win in one move as the Negamax function does not support this
     // case.
-    return (Position::WIDTH * Position::HEIGHT + 1 - P.NumMoves()) / 2;
+    result.min = result.max =
+        (Position::WIDTH * Position::HEIGHT + 1 - P.NumMoves()) / 2;
+    return result;
   }
 
+  const uint64_t root_start_nodes = nodeCount;
   int min = -((Position::WIDTH * Position::HEIGHT) - P.NumMoves()) / 2;
   int max = (Position::WIDTH * Position::HEIGHT + 1 - P.NumMoves()) / 2;
+  if (config.weak) {
+    // only the sign of the score matters, so search the [-1, 1] window
+    min = std::max(min, -1);
+    max = std::min(max, 1);
+  }
+  if (config.forcing_search) {
+    const int length = FindForcedWin(P);
+    if (length >= 0) {
+      // a lower bound only, a faster win may need quiet moves
+      min = std::max(min, std::min(max, (Position::WIDTH * Position::HEIGHT +
+                                         1 - P.NumMoves() - 2 * length) /
+                                            2));
+    }
+  }
+  if (const int val = static_cast<int>(TableGet(P, key))) {
+    // the memoization table only holds an upper bound
+    max = std::min(max, val + Position::MIN_SCORE - 1);
+  }
+  if (config.zugzwang_rules && max > 0 && ProveNoWin(P)) {
+    max = 0;
+  }
+  min = std::max(min, std::min(max, lower_bound));
 
-  while (min < max) {
+  while (min < max && !stopped) {
     // iteratively narrow the min-max exploration window
     int med = min + ((max - min) / 2);
     if (med <= 0 && min / 2 < med) {
@@ -117,23 +750,139 @@ int Solver::Solve(const Position &P) {
     } else if (med >= 0 && max / 2 > med) {
       med = max / 2;
     }
-    const int r = Negamax(P, med, med + 1);
     // use a null depth window to know if the actual score is greater or
     // smaller than med
+    const int proof =
+        backend == SearchBackend::kProofNumber ? ProofNumber(P, med) : 0;
+    int r = proof > 0 ? med + 1 : med;
+    if (proof == 0 && !stopped) {
+      r = Negamax(P, med, med + 1);
+    }
+    if (stopped) {
+      break;  // r is meaningless, keep the bounds proven so far
+    }
     if (r <= med) {
       max = r;
     } else {
       min = r;
     }
+    if (progressCallback != nullptr) {
+      (*progressCallback)({min, max, nodeCount - searchStartNodes});
+    }
+  }
+
+  result.min = min;
+  result.max = std::max(min, max);
+  result.nodes = nodeCount - searchStartNodes;
+  result.stopped = stopped;
+  if (config.solved_log && !config.weak && result.IsExact()) {
+    config.solved_log->Append(
+        {key, static_cast<uint8_t>(min - Position::MIN_SCORE + 1),
+         nodeCount - root_start_nodes});
   }
-  return min;
+  return result;
 }
 
 int Solver::FindBestMove(const Position &P) {
+  QueryScope query(*this, "find_best_move", P);
+  const int move = ChooseMove(P);
+  query.Finish({move});
+  return move;
+}
+
+int Solver::FindBestMove(const Position &P, const SearchLimits &limits) {
+  QueryScope query(*this, "find_best_move_limited", P, &limits);
+  const int move = ChooseMove(P, limits);
+  query.Finish({move});
+  return move;
+}
+
+GameAnalysis Solver::AnalyzeGame(const Position &start,
+                                 const std::string_view sequence) {
+  constexpr int CELLS = Position::WIDTH * Position::HEIGHT;
+  const auto start_time = std::chrono::steady_clock::now();
+  const uint64_t start_nodes = nodeCount;
+  GameAnalysis analysis;
+
+  // positions[k] is the position before move k, a winning move ends the game
+  std::vector<Position> positions(1, start);
+  bool won = false;
+  for (const char move : sequence) {
+    const Position &P = positions.back();
+    const int col = move - '1';
+    if (won || col < 0 || col >= Position::WIDTH || !P.CanPlay(col)) {
+      break;
+    }
+    analysis.plies.push_back({col});
+    if (P.IsWinningMove(col)) {
+      won = true;
+    } else {
+      positions.push_back(P);
+      positions.back().PlayCol(col);
+    }
+  }
+
+  // the score of the move played is a lower bound of the position before it,
+  // which narrows the window the earlier and more expensive positions are
+  // searched in
+  std::vector<int> scores(positions.size());
+  int lower_bound = INT_MIN;
+  for (size_t k = positions.size(); k-- > 0;) {
+    const Position &P = positions[k];
+    if (P.NumMoves() < CELLS) {
+      C4_PROFILE_SCOPE(kSolve);
+      QueryScope query(*this, "solve", P);
+      scores[k] = SolveRoot(P, lower_bound).min;
+      if (config.weak) {
+        scores[k] = std::clamp(scores[k], -1, 1);
+      }
+      query.Finish({scores[k]});
+    }
+    lower_bound = -scores[k];
+  }
+
+  auto outcome = [](const int score) { return (score > 0) - (score < 0); };
+  for (size_t k = 0; k < analysis.plies.size(); k++) {
+    PlyAnalysis &ply = analysis.plies[k];
+    ply.best_score = scores[k];
+    if (k + 1 < scores.size()) {
+      ply.played_score = -scores[k + 1];
+    } else {
+      // the game ends with this winning move
+      ply.played_score = (CELLS + 1 - positions[k].NumMoves()) / 2;
+      if (config.weak) {
+        ply.played_score = 1;
+      }
+    }
+    if (outcome(ply.played_score) < outcome(ply.best_score)) {
+      ply.quality = MoveQuality::kBlunder;
+    } else if (ply.played_score < ply.best_score) {
+      ply.quality = MoveQuality::kInaccuracy;
+    }
+  }
+
+  analysis.nodes = nodeCount - start_nodes;
+  const std::chrono::duration<double, std::milli> time_taken =
+      std::chrono::steady_clock::now() - start_time;
+  analysis.time_ms = time_taken.count();
+  return analysis;
+}
+
+RankedMoves Solver::Analyze(const Position &P) {
+  QueryScope query(*this, "analyze", P);
+  const RankedMoves ranked_moves = RankMoves(P);
+  // only the best moves are recorded
+  query.Finish(ranked_moves.columns.data(),
+               ranked_moves.columns.data() + ranked_moves.BestCount());
+  return ranked_moves;
+}
+
+int Solver::ChooseMove(const Position &P) {
   if (P.isEmpty()) {
     return ((Position::WIDTH + 1) / 2) - 1;
   }
-  std::vector<int> best_cols;
+  std::array<int, Position::WIDTH> best_cols{};
+  int best_count = 0;
   int best_score = INT_MIN;
   for (int col = 0; col < Position::WIDTH; ++col) {
     if (P.CanPlay(col)) {
@@ -146,111 +895,314 @@ int Solver::FindBestMove(const Position &P) {
 
       if (score > best_score) {
         best_score = score;
-        best_cols.clear();
-        best_cols.push_back(col);
+        best_count = 0;
+        best_cols.at(best_count++) = col;
       } else if (score == best_score) {
-        best_cols.push_back(col);
+        best_cols.at(best_count++) = col;
       }
     }
   }
 
-  std::random_device rd;
-  std::mt19937 gen(rd());
-  std::uniform_int_distribution<> dist(0,
-                                       static_cast<int>(best_cols.size() - 1));
-  return best_cols[dist(gen)];
+  std::uniform_int_distribution<> dist(0, best_count - 1);
+  return best_cols.at(dist(rng));
 }
 
-std::vector<std::vector<int>> Solver::Analyze(const Position &P) {
-  std::vector<std::vector<int>> ranked_moves;
-  std::map<int, std::vector<int>, std::greater<>> score_to_cols;
-
-  std::random_device rd;
-  std::mt19937 g(rd());
-
+int Solver::ChooseMove(const Position &P, const SearchLimits &limits) {
   if (P.isEmpty()) {
-    int middle_col = ((Position::WIDTH + 1) / 2) - 1;
-    ranked_moves.push_back({middle_col});
-    return ranked_moves;
+    return ((Position::WIDTH + 1) / 2) - 1;
   }
-
-  std::vector<int> winning_cols;
   for (int col = 0; col < Position::WIDTH; ++col) {
     if (P.CanPlay(col) && P.IsWinningMove(col)) {
-      winning_cols.push_back(col);
+      return col;
     }
   }
 
-  if (!winning_cols.empty()) {
-    std::shuffle(winning_cols.begin(), winning_cols.end(), g);
-    ranked_moves.push_back(winning_cols);
+  BeginSearch(limits);
+  progressCallback = nullptr;
+  int best_col = -1;
+  int best_min = INT_MIN;
+  int best_max = INT_MIN;
+  for (const int col : columnOrder) {
+    if (!P.CanPlay(col)) {
+      continue;
+    }
+    Position P2(P);
+    P2.PlayCol(col);
+    // once stopped, the remaining columns only get their widest bounds
+    const SolveResult child = SolveRoot(P2);
+    const int move_min = -child.max;
+    const int move_max = -child.min;
+    if (move_min > best_min || (move_min == best_min && move_max > best_max)) {
+      best_col = col;
+      best_min = move_min;
+      best_max = move_max;
+    }
+  }
+  EndSearch();
+  return best_col;
+}
+
+RankedMoves Solver::RankMoves(const Position &P) {
+  RankedMoves ranked_moves;
+
+  if (P.isEmpty()) {
+    ranked_moves.columns.at(0) = ((Position::WIDTH + 1) / 2) - 1;
+    ranked_moves.scores.at(0) = Solve(P);
+    ranked_moves.count = 1;
     return ranked_moves;
   }
 
   for (int col = 0; col < Position::WIDTH; ++col) {
-    if (P.CanPlay(col)) {
-      Position P2(P);
-      P2.PlayCol(col);
-      int score = -Solve(P2);
+    if (P.CanPlay(col) && P.IsWinningMove(col)) {
+      ranked_moves.columns.at(ranked_moves.count) = col;
+      ranked_moves.scores.at(ranked_moves.count++) =
+          (Position::WIDTH * Position::HEIGHT + 1 - P.NumMoves()) / 2;
+    }
+  }
+
+  if (ranked_moves.count == 0) {
+    for (int col = 0; col < Position::WIDTH; ++col) {
+      if (P.CanPlay(col)) {
+        Position P2(P);
+        P2.PlayCol(col);
+        const int score = -Solve(P2);
 
-      score_to_cols[score].push_back(col);
+        // insertion by decreasing score
+        int i = ranked_moves.count++;
+        for (; i > 0 && ranked_moves.scores.at(i - 1) < score; i--) {
+          ranked_moves.columns.at(i) = ranked_moves.columns.at(i - 1);
+          ranked_moves.scores.at(i) = ranked_moves.scores.at(i - 1);
+        }
+        ranked_moves.columns.at(i) = col;
+        ranked_moves.scores.at(i) = score;
+      }
     }
   }
 
-  for (auto &[score, cols] : score_to_cols) {
-    std::shuffle(cols.begin(), cols.end(), g);
-    ranked_moves.push_back(cols);
+  for (int first = 0, last = 0; first < ranked_moves.count; first = last) {
+    while (last < ranked_moves.count &&
+           ranked_moves.scores.at(last) == ranked_moves.scores.at(first)) {
+      last++;
+    }
+    std::shuffle(ranked_moves.columns.begin() + first,
+                 ranked_moves.columns.begin() + last, rng);
   }
 
   return ranked_moves;
 }
 
+std::vector<int> Solver::PrincipalVariation(const Position &P) {
+  QueryScope query(*this, "principal_variation", P);
+  std::vector<int> line;
+  Position pos(P);
+  if (pos.isEmpty()) {
+    line.push_back(DEFAULT_FIRST_MOVE);
+    pos.PlayCol(DEFAULT_FIRST_MOVE);
+  }
+
+  while (pos.NumMoves() < Position::WIDTH * Position::HEIGHT) {
+    int winning_col = -1;
+    for (int col = 0; col < Position::WIDTH && winning_col < 0; col++) {
+      if (pos.CanPlay(col) && pos.IsWinningMove(col)) {
+        winning_col = col;
+      }
+    }
+    if (winning_col >= 0) {
+      line.push_back(winning_col);
+      break;
+    }
+
+    const int score = Solve(pos);
+    bool mirrored = false;
+    uint8_t stored_move = 0;
+    TableGet(pos, pos.Key3(mirrored), stored_move);
+
+    // the hash move is almost always the move keeping the score, the others
+    // are only solved when it is missing or was overwritten
+    std::array<int, Position::WIDTH + 1> candidates{};
+    candidates[0] = stored_move != 0 ? fromStoredMove(stored_move, mirrored)
+                                     : columnOrder[0];
+    std::copy(columnOrder.begin(), columnOrder.end(), candidates.begin() + 1);
+
+    int next_col = -1;
+    for (const int col : candidates) {
+      if (!pos.CanPlay(col)) {
+        continue;
+      }
+      Position P2(pos);
+      P2.PlayCol(col);
+      if (-Solve(P2) == score) {
+        next_col = col;
+        break;
+      }
+    }
+    if (next_col < 0) {
+      break;
+    }
+    line.push_back(next_col);
+    pos.PlayCol(next_col);
+  }
+
+  query.Finish(line);
+  return line;
+}
+
 std::array<int, Position::WIDTH> Solver::ScoreColumns(const Position &P) {
+  QueryScope query(*this, "score_columns", P);
   std::array<int, Position::WIDTH> score_list{};
+  ScoreColumns(P, [&score_list](const int col, const int score) {
+    score_list.at(col) = score;
+  });
+  query.Finish(score_list);
+  return score_list;
+}
+
+void Solver::ScoreColumns(
+    const Position &P,
+    const std::function<void(int col, int score)> &on_score) {
+  QueryScope query(*this, "score_columns", P);
+  std::array<int, Position::WIDTH> score_list{};
+  const auto report = [&](const int col, const int score) {
+    score_list.at(col) = score;
+    on_score(col, score);
+  };
+
+  // number of replies left to the opponent and column of the moves which
+  // need a search
+  std::array<std::pair<int, int>, Position::WIDTH> pending{};
+  int pending_count = 0;
 
   for (int col = 0; col < Position::WIDTH; ++col) {
-    if (P.CanPlay(col)) {
-      if (P.IsWinningMove(col)) {
-        score_list.at(col) = (Position::WIDTH * Position::HEIGHT + 1 - P.NumMoves()) / 2;
-        continue;
+    if (P.CanPlay(col) && P.IsWinningMove(col)) {
+      report(col, (Position::WIDTH * Position::HEIGHT + 1 - P.NumMoves()) / 2);
+    }
+  }
+
+  for (int col = 0; col < Position::WIDTH; ++col) {
+    if (!P.CanPlay(col) || P.IsWinningMove(col)) {
+      continue;
+    }
+    Position P2(P);
+    P2.PlayCol(col);
+    if (P2.CanWinNext()) {
+      report(col, -Solve(P2));  // solved without any search
+    } else {
+      // insertion sort by number of replies, at most WIDTH columns, keeping
+      // the column order among equal counts
+      const int replies = __builtin_popcountll(P2.PossibleNonLosingMoves());
+      int i = pending_count++;
+      for (; i != 0 && pending.at(i - 1).first > replies; --i) {
+        pending.at(i) = pending.at(i - 1);
       }
-      Position P2(P);
-      P2.PlayCol(col);
-      const int score = -Solve(P2);
+      pending.at(i) = {replies, col};
+    }
+  }
 
-      score_list.at(col) = score;
+  // a first pass on a small node budget reports the columns which are quick
+  // to solve before the hard ones hold everything up
+  SearchLimits quick_limits;
+  quick_limits.max_nodes = QUICK_SCORE_NODES;
+  std::array<int, Position::WIDTH> hard{};
+  int hard_count = 0;
+  for (int i = 0; i < pending_count; i++) {
+    const int col = pending.at(i).second;
+    Position P2(P);
+    P2.PlayCol(col);
+    const SolveResult result = Solve(P2, quick_limits);
+    if (result.IsExact()) {
+      report(col, -result.min);
+    } else {
+      hard.at(hard_count++) = col;
     }
   }
 
-  return score_list;
+  for (int i = 0; i < hard_count; i++) {
+    const int col = hard.at(i);
+    Position P2(P);
+    P2.PlayCol(col);
+    report(col, -Solve(P2));
+  }
+
+  query.Finish(score_list);
 }
 
 int Solver::RandomMove() {
-  std::random_device rd;
-  std::mt19937 gen(rd());
   std::uniform_int_distribution<> dist(0, Position::WIDTH - 1);
-  return dist(gen);
+  return dist(rng);
+}
+
+void Solver::StartTrace() {
+  traceId = config.trace->AddSolver(config, seed);
+}
+
+void Solver::RecordReset() {
+  if (queryDepth == 0) {
+    TraceQuery query;
+    query.solver = traceId;
+    query.query = "reset";
+    config.trace->Record(query);
+  }
+}
+
+Solver::QueryScope::QueryScope(Solver &querying_solver, const char *query_name,
+                               const Position &P, const SearchLimits *limits)
+    : solver(querying_solver),
+      active(querying_solver.traceId >= 0 && querying_solver.queryDepth == 0),
+      name(query_name),
+      mask(P.GetMask()),
+      position(P.GetCurrentPosition()),
+      start_nodes(querying_solver.nodeCount) {
+  if (solver.queryDepth++ == 0 && solver.bookSource) {
+    solver.RefreshBook();
+  }
+  if (active) {
+    if (limits != nullptr) {
+      max_nodes = limits->max_nodes;
+      max_time_ms = limits->max_time.count();
+      backend = limits->backend;
+    }
+    start = std::chrono::steady_clock::now();
+  }
+}
+
+void Solver::QueryScope::Record(const std::vector<int> &result) const {
+  const std::chrono::duration<double, std::micro> time_taken =
+      std::chrono::steady_clock::now() - start;
+  TraceQuery query;
+  query.solver = solver.traceId;
+  query.query = name;
+  query.mask = mask;
+  query.current_position = position;
+  query.max_nodes = max_nodes;
+  query.max_time_ms = max_time_ms;
+  query.backend = backend;
+  query.result = result;
+  query.nodes = solver.nodeCount - start_nodes;
+  query.time_us = time_taken.count();
+  solver.config.trace->Record(query);
 }
 
 void Solver::GetReady(const std::string &OPENING_BOOK_PATH,
-                      const std::string &WARMUP_BOOK_PATH) const {
+                      const std::string &WARMUP_BOOK_PATH) {
   using hr_clock = std::chrono::high_resolution_clock;
-  const auto open_start = hr_clock::now();
-  LoadOpeningBook(OPENING_BOOK_PATH);
-  const auto open_end = hr_clock::now();
-  const std::chrono::duration<double> open_taken = open_end - open_start;
-  const size_t open_num_moves = transTable.GetOpeningTableSize();
-
-  const auto warmup_start = hr_clock::now();
-  Warmup(WARMUP_BOOK_PATH);
-  const auto warmup_end = hr_clock::now();
-  const std::chrono::duration<double> warmup_taken = warmup_end - warmup_start;
-  const size_t warmup_num_moves =
-      transTable.GetOpeningTableSize() - open_num_moves;
-
-  std::cout << "Opening book: loaded " << open_num_moves << " moves in "
-            << open_taken.count() << " seconds.\n";
-  std::cout << "Warmup book: loaded " << warmup_num_moves << " moves in "
-            << warmup_taken.count() << " seconds.\n";
+  const auto load_start = hr_clock::now();
+  SetBookSource(
+      std::make_shared<BookSource>(OPENING_BOOK_PATH, WARMUP_BOOK_PATH));
+  const auto load_end = hr_clock::now();
+  const std::chrono::duration<double> load_taken = load_end - load_start;
+
+  std::cout << "Opening book: loaded " << book->GetOpeningCount()
+            << " moves.\n";
+  std::cout << "Warmup book: loaded " << book->GetWarmupCount()
+            << " moves.\n";
+  std::cout << "Books loaded in " << load_taken.count() << " seconds.\n";
   std::cout.flush();
 }
+
+void Solver::RefreshBook() {
+  const uint64_t generation = bookSource->GetGeneration();
+  if (generation != bookGeneration) {
+    bookGeneration = generation;
+    book = bookSource->Get();
+  }
+}
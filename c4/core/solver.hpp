@@ -1,65 +1,592 @@
 #pragma once
 
 #include <array>
+#include <atomic>
+#include <chrono>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
+#include "book_source.hpp"
+#include "near_leaf_table.hpp"
 #include "opening_book.hpp"
 #include "position.hpp"
+#include "solved_log.hpp"
 #include "transposition_table.hpp"
+#include "zugzwang_rules.hpp"
+
+class TraceRecorder;
+
+// Score used by Negamax to sort the moves of a position
+enum class MoveOrdering {
+  kThreatCount,   // number of threats the move creates, Position::MoveScore
+  kThreatParity,  // threats weighted by parity, Position::MoveScoreParity
+};
+
+// Algorithm answering the null-window tests "is the score above med" that
+// Solve narrows the score with
+enum class SearchBackend {
+  kNegamax,
+  // Best-first proof-number search over a node pool of
+  // SolverConfig::proof_nodes nodes, see Solver::ProofNumber. A test the
+  // pool is too small for is handed over to Negamax.
+  kProofNumber,
+};
+
+// Tunable search parameters, the defaults are what the CLI uses
+struct SolverConfig {
+  // memoization table size: 2^23: 8388617, 2^24: 16777259,
+  // 2^25: 33554467, 2^26: 67108879, 2^27: 134217757
+  size_t table_size = 8388617;
+
+  // Number of empty cells at or below which Negamax hands the position over
+  // to the TT-free endgame search, 0 disables the endgame search
+  int endgame_threshold = 12;
+
+  // Only find out whether the position is won, drawn or lost: Solve returns
+  // 1, 0 or -1 instead of the exact score, which is much faster
+  bool weak = false;
+
+  // Store the best or cutoff move of every position in the transposition
+  // table and try it first when the position is searched again
+  bool hash_move = true;
+
+  MoveOrdering move_ordering = MoveOrdering::kThreatCount;
+
+  // Before searching a position, look for a win made of moves each
+  // threatening to win at once, see Solver::FindForcedWin. Negamax also
+  // probes for short ones when its window asks for a win.
+  bool forcing_search = false;
+
+  // Before searching the moves of a position, look up the positions they
+  // lead to and cut at once when one of their stored bounds already proves
+  // the cutoff, see Solver::EnhancedCutoff
+  bool enhanced_cutoffs = false;
+
+  // Before searching a position the first player could win, try to prove
+  // with the claimeven, baseinverse and vertical rules that they cannot, see
+  // ProvesNoWin. A proof bounds the score by 0 and is stored in the
+  // transposition table.
+  bool zugzwang_rules = false;
+
+  // Backend of the queries whose limits do not pick one
+  SearchBackend backend = SearchBackend::kNegamax;
+
+  // Nodes of the proof-number search pool, 16 bytes each, allocated the
+  // first time the backend is used
+  size_t proof_nodes = 1 << 20;
+
+  // Entries of a small table, 16 bytes each, holding the positions with at
+  // least near_leaf_ply moves played apart from the main table, see
+  // NearLeafTable. 0 keeps every position in the main table.
+  size_t near_leaf_table_size = 65537;
+  int near_leaf_ply = 24;
+
+  // Name of a POSIX shared memory segment holding the memoization table, so
+  // that solver processes of a host share their results. Empty for a private
+  // table.
+  std::string shared_table;
+
+  // Seed of the choice among equally good moves, 0 for a random seed
+  uint32_t seed = 0;
+
+  // Record every query into this trace, see TraceRecorder
+  std::shared_ptr<TraceRecorder> trace;
+
+  // Append the exact score of every position solved by a search to this
+  // log, see SolvedLog. Weak solvers do not know exact scores and log
+  // nothing.
+  std::shared_ptr<SolvedLog> solved_log;
+};
+
+// Bounds of the score of a position. They are equal once the position is
+// solved, a search stopped early returns the best bounds it proved.
+struct SolveResult {
+  int min = 0;
+  int max = 0;
+  uint64_t nodes = 0;  // nodes explored by this search
+  bool stopped = false;
+
+  bool IsExact() const { return min == max; }
+};
+
+// Reported by Solve after every step of its window narrowing
+struct SearchProgress {
+  int min;
+  int max;
+  uint64_t nodes;
+};
+
+// Ways to stop a search before it finishes, all of them optional. They are
+// checked every STOP_CHECK_INTERVAL nodes, so a stopped search overshoots by
+// at most that many nodes. The backend of the search can also be picked per
+// query.
+struct SearchLimits {
+  // set to true from any thread to stop the search
+  const std::atomic<bool> *cancel = nullptr;
+
+  // 0 for no limit
+  uint64_t max_nodes = 0;
+
+  // 0 for no limit
+  std::chrono::milliseconds max_time{0};
+
+  std::function<void(const SearchProgress &)> on_progress;
+
+  // instead of SolverConfig::backend
+  std::optional<SearchBackend> backend;
+};
+
+// Outcome of the forcing searches run by a solver since it was created
+struct ForcingStats {
+  uint64_t searches = 0;  // before solving a position
+  uint64_t wins = 0;      // searches which found a forced win
+  uint64_t nodes = 0;     // nodes of those searches
+  uint64_t probes = 0;    // inside Negamax
+  uint64_t probe_cutoffs = 0;  // probes which found a win above the window
+};
+
+// Outcome of the enhanced transposition cutoffs tried by a solver since it
+// was created
+struct EnhancedCutoffStats {
+  uint64_t searches = 0;  // positions whose children were looked up
+  uint64_t cutoffs = 0;   // positions cut without searching a child
+};
+
+// Outcome of the zugzwang rule proofs tried by a solver since it was
+// created
+struct ZugzwangStats {
+  uint64_t probes = 0;
+  uint64_t proofs = 0;  // positions proved not won by the player to move
+};
+
+// Outcome of the proof-number searches run by a solver since it was created
+struct ProofNumberStats {
+  uint64_t searches = 0;   // null-window tests
+  uint64_t proofs = 0;     // tests proving the score is above the window
+  uint64_t disproofs = 0;  // tests proving it is not
+  uint64_t fallbacks = 0;  // tests handed over to Negamax, the pool was full
+  uint64_t nodes = 0;      // nodes evaluated by the searches
+};
+
+// Playable moves of a position ranked by score, kept in fixed storage so that
+// ranking the moves does not allocate
+struct RankedMoves {
+  // columns from the best score to the worst, in random order among equal
+  // scores
+  std::array<int, Position::WIDTH> columns{};
+  std::array<int, Position::WIDTH> scores{};
+  int count = 0;
+
+  // number of columns sharing the best score, they come first
+  int BestCount() const {
+    int best = 0;
+    while (best < count && scores.at(best) == scores.at(0)) {
+      best++;
+    }
+    return best;
+  }
+};
+
+enum class MoveQuality {
+  kBest,
+  kInaccuracy,  // keeps the outcome, but wins later or loses sooner
+  kBlunder,     // turns a win into a draw or a loss, or a draw into a loss
+};
+
+// One move of a game analyzed by Solver::AnalyzeGame, scores are from the
+// point of view of the player making the move
+struct PlyAnalysis {
+  int column = 0;  // 0-based
+  int best_score = 0;    // score of the position before the move
+  int played_score = 0;  // score of the position after the move
+  MoveQuality quality = MoveQuality::kBest;
+};
+
+struct GameAnalysis {
+  std::vector<PlyAnalysis> plies;
+  uint64_t nodes = 0;
+  double time_ms = 0;
+};
 
 class Solver {
  public:
+  static constexpr uint64_t STOP_CHECK_INTERVAL = 4096;
+  // node budget under which the streaming ScoreColumns solves easy columns
+  // first
+  static constexpr uint64_t QUICK_SCORE_NODES = 20000;
+  // node budget of the forcing search run before solving a position
+  static constexpr uint64_t FORCING_SEARCH_NODES = 2000;
+  // forcing moves, node budget and empty cells above which Negamax probes
+  // for a forced win
+  static constexpr int FORCING_PROBE_DEPTH = 3;
+  static constexpr uint64_t FORCING_PROBE_NODES = 200;
+  static constexpr int FORCING_PROBE_MIN_EMPTY = 16;
+  // proof or disproof number of a decided proof-number search node
+  static constexpr uint32_t PROOF_INFINITY = UINT32_C(1) << 30;
+
   static constexpr int DEFAULT_FIRST_MOVE = 3;
 
-  Solver() : transTable(TABLE_SIZE) {
+  Solver() : Solver(SolverConfig{}) {}
+
+  explicit Solver(const SolverConfig &solver_config)
+      : transTable(solver_config.table_size, solver_config.shared_table),
+        nearLeafTable(solver_config.near_leaf_table_size),
+        config(solver_config),
+        seed(solver_config.seed != 0 ? solver_config.seed
+                                     : std::random_device{}()),
+        rng(seed),
+        backend(solver_config.backend) {
+    if (!config.shared_table.empty() && !transTable.IsShared()) {
+      std::cerr << "Cannot attach shared table " << config.shared_table
+                << " (" << transTable.GetSharedError()
+                << "), using a private table.\n";
+    }
     Reset();
     for (int i = 0; i < Position::WIDTH; i++) {
       columnOrder.at(i) = Position::WIDTH / 2 + (1 - 2 * (i % 2)) * (i + 1) / 2;
     }
     // initialize the column exploration order, starting with center columns
     // example for WIDTH=7: columnOrder = {3, 4, 2, 5, 1, 6, 0}
+    if (config.trace) {
+      StartTrace();
+    }
   }
 
   int Solve(const Position &P);
 
+  // Solve within limits, the result is exact unless the search was stopped
+  SolveResult Solve(const Position &P, const SearchLimits &limits);
+
   int FindBestMove(const Position &P);
 
-  std::vector<std::vector<int> > Analyze(const Position &P);
+  // Best move found within limits: the move with the best proven lower
+  // bound, columns are searched from the center. Progress is not reported.
+  int FindBestMove(const Position &P, const SearchLimits &limits);
+
+  // Whether the last search run with limits was stopped before the end
+  bool WasStopped() const { return lastSearchStopped; }
+
+  // Moves from the best to the worst. A position with an immediate win only
+  // ranks the winning moves.
+  RankedMoves Analyze(const Position &P);
 
   std::array<int, Position::WIDTH> ScoreColumns(const Position &P);
 
-  static int RandomMove();
+  // Same scores as ScoreColumns, each handed to on_score as soon as it is
+  // proven. Immediate wins come first, then the moves letting the opponent
+  // win at once, then the moves solved within QUICK_SCORE_NODES nodes, then
+  // the others. Moves are tried in increasing order of how many replies they
+  // leave the opponent. Unplayable columns are not reported.
+  void ScoreColumns(const Position &P,
+                    const std::function<void(int col, int score)> &on_score);
+
+  // Sequence of columns (0-based) both players follow from P when they play
+  // perfectly, until the end of the game. The moves stored in the
+  // transposition table are tried first, so this mostly costs table lookups.
+  std::vector<int> PrincipalVariation(const Position &P);
+
+  // Score every move of a game given as a sequence of 1-based columns, up to
+  // its first invalid move: plies.size() tells how many moves were valid.
+  // The positions are solved from the last one back to the start, so that
+  // the expensive early positions find the table primed by the later ones.
+  // Every position is traced as a solve query.
+  GameAnalysis AnalyzeGame(std::string_view sequence) {
+    return AnalyzeGame(Position(), sequence);
+  }
+
+  // Same as AnalyzeGame, for the moves played from start on
+  GameAnalysis AnalyzeGame(const Position &start, std::string_view sequence);
+
+  int RandomMove();
+
+  // Use a book loaded once with OpeningBook::Load, it can be shared by any
+  // number of solvers. Null for no book.
+  void SetOpeningBook(std::shared_ptr<const OpeningBook> opening_book) {
+    book = std::move(opening_book);
+    bookSource.reset();
+  }
+
+  // Use the current book of source and follow its reloads: every query
+  // starts with the book in place when it starts. Null for no book.
+  void SetBookSource(std::shared_ptr<BookSource> source) {
+    bookSource = std::move(source);
+    book = nullptr;
+    if (bookSource) {
+      bookGeneration = bookSource->GetGeneration();
+      book = bookSource->Get();
+    }
+  }
 
-  void LoadOpeningBook(const std::string &OPENING_BOOK_PATH) const {
-    book.load(OPENING_BOOK_PATH);
+  const std::shared_ptr<const OpeningBook> &GetOpeningBook() const {
+    return book;
   }
 
-  void Warmup(const std::string &WARMUP_BOOK_PATH) const {
-    book.load(WARMUP_BOOK_PATH);
+  const std::shared_ptr<BookSource> &GetBookSource() const {
+    return bookSource;
   }
 
+  // Load the books for this solver, reloadable through GetBookSource, and
+  // print how long it took
   void GetReady(const std::string &OPENING_BOOK_PATH,
-                const std::string &WARMUP_BOOK_PATH) const;
+                const std::string &WARMUP_BOOK_PATH);
+
+  // Remember the exact score of a position, encoded like a book score, for
+  // the lifetime of this solver. The shared book is left untouched.
+  void AddKnownScore(const uint64_t key, const uint8_t score) {
+    knownScores.emplace(key, score);
+  }
 
   void Reset() {
+    if (traceId >= 0) {
+      RecordReset();
+    }
     nodeCount = 0;
     transTable.Reset();
+    nearLeafTable.Reset();
   }
 
   uint64_t GetNodeCount() const { return nodeCount; }
 
+  const ForcingStats &GetForcingStats() const { return forcingStats; }
+
+  const EnhancedCutoffStats &GetEnhancedCutoffStats() const {
+    return enhancedCutoffStats;
+  }
+
+  const ZugzwangStats &GetZugzwangStats() const { return zugzwangStats; }
+
+  const ProofNumberStats &GetProofNumberStats() const {
+    return proofNumberStats;
+  }
+
   TranspositionTable &GetTranspositionTable() { return transTable; }
 
+  const TranspositionTable &GetTranspositionTable() const {
+    return transTable;
+  }
+
+  const NearLeafTable &GetNearLeafTable() const { return nearLeafTable; }
+
+  const SolverConfig &GetConfig() const { return config; }
+
+  // seed actually used, drawn at random when SolverConfig::seed is 0
+  uint32_t GetSeed() const { return seed; }
+
  private:
-  // memoization table size: 2^23: 8388617, 2^24: 16777259,
-  // 2^25: 33554467, 2^26: 67108879, 2^27: 134217757
-  static constexpr int TABLE_SIZE = 8388617;
   TranspositionTable transTable;
-  OpeningBook book = OpeningBook(&transTable);
+  NearLeafTable nearLeafTable;
+  std::shared_ptr<const OpeningBook> book;
+  std::shared_ptr<BookSource> bookSource;
+  uint64_t bookGeneration = 0;  // of bookSource when book was taken from it
+  robin_hood::unordered_flat_map<uint64_t, uint8_t> knownScores;
   uint64_t nodeCount = 0;
+  ForcingStats forcingStats;
+  uint64_t forcingNodesLeft = 0;
+  bool forcingDepthReached = false;
+  EnhancedCutoffStats enhancedCutoffStats;
+  ZugzwangStats zugzwangStats;
+  ProofNumberStats proofNumberStats;
+  SolverConfig config;
+  uint32_t seed;
+  std::mt19937 rng;
 
   // Use a column order to set priority for exploring nodes (columns tend to
   // affect the game more the more they are near the middle)
   std::array<int, Position::WIDTH> columnOrder{};
 
-  int Negamax(const Position &P, int alpha, int beta);
+  // state of the search run with limits, nextStopCheck is never reached
+  // when there are none
+  const std::atomic<bool> *cancelFlag = nullptr;
+  const std::function<void(const SearchProgress &)> *progressCallback =
+      nullptr;
+  uint64_t searchStartNodes = 0;
+  uint64_t nodeLimit = UINT64_MAX;
+  uint64_t nextStopCheck = UINT64_MAX;
+  bool hasDeadline = false;
+  std::chrono::steady_clock::time_point deadline;
+  bool stopped = false;
+  bool lastSearchStopped = false;
+  // of the running query, config.backend unless its limits pick another one
+  SearchBackend backend;
+
+  // Node of the proof-number search tree. The root is the node 0 and the
+  // children of a node are stored next to each other, the position of a
+  // node is replayed from the root along the columns.
+  struct ProofNode {
+    uint32_t proof;
+    uint32_t disproof;
+    uint32_t first_child;  // 0 until the node is expanded
+    uint8_t child_count;
+    uint8_t column;  // played by the parent to reach the node
+  };
+  std::vector<ProofNode> proofNodes;
+
+  // id of this solver in config.trace, -1 when not traced
+  int traceId = -1;
+  // number of API calls in progress, API calls made by another one are part
+  // of it
+  int queryDepth = 0;
+
+  // Scope of an API call. The outermost call picks up a reloaded book when
+  // it starts, and is timed and recorded into config.trace. Query names:
+  // solve, solve_limited, find_best_move, find_best_move_limited, analyze,
+  // score_columns, principal_variation and reset.
+  class QueryScope {
+   public:
+    QueryScope(Solver &querying_solver, const char *query_name,
+               const Position &P, const SearchLimits *limits = nullptr);
+    ~QueryScope() { solver.queryDepth--; }
+
+    QueryScope(const QueryScope &) = delete;
+    QueryScope &operator=(const QueryScope &) = delete;
+
+    void Finish(std::initializer_list<int> result) {
+      if (active) {
+        Record(std::vector<int>(result));
+      }
+    }
+
+    template <class Container>
+    void Finish(const Container &result) {
+      Finish(result.data(), result.data() + result.size());
+    }
+
+    void Finish(const int *first, const int *last) {
+      if (active) {
+        Record(std::vector<int>(first, last));
+      }
+    }
+
+   private:
+    Solver &solver;
+    bool active;
+    const char *name;
+    uint64_t mask;
+    uint64_t position;
+    uint64_t max_nodes = 0;
+    int64_t max_time_ms = 0;
+    std::optional<SearchBackend> backend;
+    uint64_t start_nodes;
+    std::chrono::steady_clock::time_point start;
+
+    void Record(const std::vector<int> &result) const;
+  };
+
+  void StartTrace();
+
+  void RecordReset();
+
+  void RefreshBook();
+
+  void BeginSearch(const SearchLimits &limits);
+
+  void EndSearch();
+
+  bool CheckStop();
+
+  // lower_bound is a score already proven for P, if any
+  SolveResult SolveRoot(const Position &P, int lower_bound = INT_MIN);
+
+  // bodies of FindBestMove and Analyze, which add the tracing
+  int ChooseMove(const Position &P);
+
+  int ChooseMove(const Position &P, const SearchLimits &limits);
+
+  RankedMoves RankMoves(const Position &P);
+
+  // exact score of a book or known position, 0 if there is none
+  uint8_t GetExactScore(const uint64_t key) const {
+    if (book) {
+      if (const uint8_t score = book->Get(key)) {
+        return score;
+      }
+    }
+    if (knownScores.empty()) {
+      return 0;
+    }
+    const auto entry = knownScores.find(key);
+    return entry == knownScores.end() ? 0 : entry->second;
+  }
+
+  // positions with at least near_leaf_ply moves played are memoized in the
+  // near-leaf table when there is one, the others in the main table
+  bool IsNearLeaf(const Position &P) const {
+    return nearLeafTable.IsEnabled() && P.NumMoves() >= config.near_leaf_ply;
+  }
+
+  uint8_t TableGet(const Position &P, const uint64_t key,
+                   uint8_t &move) const {
+    return IsNearLeaf(P) ? nearLeafTable.Get(key, move)
+                         : transTable.Get(key, move);
+  }
+
+  uint8_t TableGet(const Position &P, const uint64_t key) const {
+    uint8_t move = 0;
+    return TableGet(P, key, move);
+  }
+
+  void TablePrefetch(const Position &P, const uint64_t key) const {
+    if (IsNearLeaf(P)) {
+      nearLeafTable.Prefetch(key);
+    } else {
+      transTable.Prefetch(key);
+    }
+  }
+
+  void TablePut(const Position &P, const uint64_t key, const uint8_t val,
+                const uint8_t move = 0) {
+    if (IsNearLeaf(P)) {
+      nearLeafTable.Put(key, val, move);
+    } else {
+      transTable.Put(key, val, move);
+    }
+  }
+
+  // Key3 of a position and whether it is the key of the mirrored position
+  struct PositionKey {
+    uint64_t key;  // 0 when unknown
+    bool mirrored;
+  };
+
+  // known_key is the key of P when the caller computed it already
+  int Negamax(const Position &P, int alpha, int beta,
+              const PositionKey &known_key = {});
+
+  int NegamaxEndgame(const Position &P, int alpha, int beta);
+
+  bool ProveNoWin(const Position &P) {
+    zugzwangStats.probes++;
+    if (ProvesNoWin(P)) {
+      zugzwangStats.proofs++;
+      return true;
+    }
+    return false;
+  }
+
+  int EnhancedCutoff(const Position &P, uint64_t next,
+                     const std::array<uint64_t, Position::WIDTH> &move_threats,
+                     int beta, uint64_t &cutoff_move,
+                     std::array<PositionKey, Position::WIDTH> &child_keys);
+
+  int FindForcedWin(const Position &P);
+
+  int ForcedWin(const Position &P, int depth);
+
+  int ProofNumber(const Position &P, int med);
+
+  ProofNode EvaluateProofNode(const Position &P, bool or_node, int med);
+
+  void StoreProofBound(const Position &P, const ProofNode &node, bool or_node,
+                       int med);
 };
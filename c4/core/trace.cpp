@@ -0,0 +1,177 @@
+#include "trace.hpp"
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "json/json.hpp"
+#include "position.hpp"
+
+namespace {
+// bump when the meaning of the trace lines changes
+constexpr int TRACE_VERSION = 1;
+
+const char *backendName(const SearchBackend backend) {
+  return backend == SearchBackend::kProofNumber ? "pn" : "negamax";
+}
+
+SearchBackend backendFromName(const std::string &name) {
+  return name == "pn" ? SearchBackend::kProofNumber : SearchBackend::kNegamax;
+}
+
+nlohmann::json configToJson(const SolverConfig &config) {
+  return {{"table_size", config.table_size},
+          {"endgame_threshold", config.endgame_threshold},
+          {"weak", config.weak},
+          {"hash_move", config.hash_move},
+          {"move_ordering",
+           config.move_ordering == MoveOrdering::kThreatParity ? "parity"
+                                                               : "count"},
+          {"forcing_search", config.forcing_search},
+          {"enhanced_cutoffs", config.enhanced_cutoffs},
+          {"zugzwang_rules", config.zugzwang_rules},
+          {"near_leaf_table_size", config.near_leaf_table_size},
+          {"near_leaf_ply", config.near_leaf_ply},
+          {"backend", backendName(config.backend)},
+          {"proof_nodes", config.proof_nodes}};
+}
+
+SolverConfig configFromJson(const nlohmann::json &json) {
+  SolverConfig config;
+  config.table_size = json.at("table_size").get<size_t>();
+  config.endgame_threshold = json.at("endgame_threshold").get<int>();
+  config.weak = json.at("weak").get<bool>();
+  config.hash_move = json.at("hash_move").get<bool>();
+  config.move_ordering = json.at("move_ordering") == "parity"
+                             ? MoveOrdering::kThreatParity
+                             : MoveOrdering::kThreatCount;
+  // traces recorded before these settings existed ran without them
+  config.forcing_search = json.value("forcing_search", false);
+  config.enhanced_cutoffs = json.value("enhanced_cutoffs", false);
+  config.zugzwang_rules = json.value("zugzwang_rules", false);
+  config.near_leaf_table_size =
+      json.value("near_leaf_table_size", static_cast<size_t>(0));
+  config.near_leaf_ply = json.value("near_leaf_ply", config.near_leaf_ply);
+  config.backend = backendFromName(json.value("backend", "negamax"));
+  config.proof_nodes = json.value("proof_nodes", config.proof_nodes);
+  return config;
+}
+}  // namespace
+
+TraceRecorder::TraceRecorder(const std::string &path) : out(path) {}
+
+int TraceRecorder::AddSolver(const SolverConfig &config, const uint32_t seed) {
+  const std::lock_guard<std::mutex> lock(mutex);
+  const int id = next_solver++;
+  const nlohmann::json line = {{"version", TRACE_VERSION},
+                               {"solver", id},
+                               {"seed", seed},
+                               {"config", configToJson(config)}};
+  out << line.dump() << '\n';
+  return id;
+}
+
+void TraceRecorder::Record(const TraceQuery &query) {
+  nlohmann::json line = {{"solver", query.solver},
+                         {"query", query.query},
+                         {"mask", query.mask},
+                         {"position", query.current_position},
+                         {"max_nodes", query.max_nodes},
+                         {"max_time_ms", query.max_time_ms},
+                         {"result", query.result},
+                         {"nodes", query.nodes},
+                         {"time_us", query.time_us}};
+  if (query.backend) {
+    line["backend"] = backendName(*query.backend);
+  }
+  const std::string text = line.dump();
+  const std::lock_guard<std::mutex> lock(mutex);
+  out << text << '\n';
+}
+
+bool ReadTrace(const std::string &path, std::vector<TraceSolver> &solvers,
+               std::vector<TraceQuery> &queries) {
+  std::ifstream in(path);
+  if (!in) {
+    return false;
+  }
+  std::string text;
+  while (std::getline(in, text)) {
+    if (text.empty()) {
+      continue;
+    }
+    const auto line = nlohmann::json::parse(text, nullptr, false);
+    if (line.is_discarded() || !line.is_object()) {
+      return false;
+    }
+    try {
+      if (line.contains("config")) {
+        if (line.at("version").get<int>() != TRACE_VERSION) {
+          return false;
+        }
+        TraceSolver solver;
+        solver.id = line.at("solver").get<int>();
+        solver.seed = line.at("seed").get<uint32_t>();
+        solver.config = configFromJson(line.at("config"));
+        solvers.push_back(solver);
+      } else {
+        TraceQuery query;
+        query.solver = line.at("solver").get<int>();
+        query.query = line.at("query").get<std::string>();
+        query.mask = line.at("mask").get<uint64_t>();
+        query.current_position = line.at("position").get<uint64_t>();
+        query.max_nodes = line.at("max_nodes").get<uint64_t>();
+        query.max_time_ms = line.at("max_time_ms").get<int64_t>();
+        if (line.contains("backend")) {
+          query.backend =
+              backendFromName(line.at("backend").get<std::string>());
+        }
+        query.result = line.at("result").get<std::vector<int>>();
+        query.nodes = line.at("nodes").get<uint64_t>();
+        query.time_us = line.at("time_us").get<double>();
+        queries.push_back(query);
+      }
+    } catch (const nlohmann::json::exception &) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ReplayQuery(Solver &solver, const TraceQuery &query,
+                 std::vector<int> &result) {
+  const Position P(query.current_position, query.mask);
+  SearchLimits limits;
+  limits.max_nodes = query.max_nodes;
+  limits.max_time = std::chrono::milliseconds(query.max_time_ms);
+  limits.backend = query.backend;
+
+  if (query.query == "solve") {
+    result = {solver.Solve(P)};
+  } else if (query.query == "solve_limited") {
+    const SolveResult solve_result = solver.Solve(P, limits);
+    result = {solve_result.min, solve_result.max};
+  } else if (query.query == "find_best_move") {
+    result = {solver.FindBestMove(P)};
+  } else if (query.query == "find_best_move_limited") {
+    result = {solver.FindBestMove(P, limits)};
+  } else if (query.query == "analyze") {
+    const RankedMoves ranked_moves = solver.Analyze(P);
+    result.assign(ranked_moves.columns.begin(),
+                  ranked_moves.columns.begin() + ranked_moves.BestCount());
+  } else if (query.query == "score_columns") {
+    const auto scores = solver.ScoreColumns(P);
+    result.assign(scores.begin(), scores.end());
+  } else if (query.query == "principal_variation") {
+    result = solver.PrincipalVariation(P);
+  } else if (query.query == "reset") {
+    solver.Reset();
+    result.clear();
+  } else {
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "solver.hpp"
+
+// A solver whose queries were recorded, with what it takes to rebuild it
+struct TraceSolver {
+  int id = 0;
+  uint32_t seed = 0;
+  SolverConfig config;
+};
+
+// One call made to the Solver API. Nested calls, like the Solve calls made
+// by FindBestMove, are part of the outermost one and not recorded.
+struct TraceQuery {
+  int solver = 0;
+  std::string query;  // see Solver::QueryScope for the names
+  uint64_t mask = 0;
+  uint64_t current_position = 0;
+  uint64_t max_nodes = 0;
+  int64_t max_time_ms = 0;
+  // picked by the limits of the query, SolverConfig::backend otherwise
+  std::optional<SearchBackend> backend;
+  // score, move, column scores or principal variation, depending on query
+  std::vector<int> result;
+  uint64_t nodes = 0;
+  double time_us = 0;
+};
+
+/**
+ * Writes the queries of any number of solvers, possibly on several threads,
+ * to a trace file of JSON lines: one line per solver, holding its
+ * configuration and seed, then one line per query. c4_replay runs a trace
+ * again to compare engine builds on recorded traffic.
+ */
+class TraceRecorder {
+ public:
+  explicit TraceRecorder(const std::string &path);
+
+  bool IsOpen() const { return out.is_open(); }
+
+  // returns the id the queries of the solver are recorded with
+  int AddSolver(const SolverConfig &config, uint32_t seed);
+
+  void Record(const TraceQuery &query);
+
+ private:
+  std::mutex mutex;
+  std::ofstream out;
+  int next_solver = 0;
+};
+
+// Read a trace written by TraceRecorder, returns false if the file cannot
+// be read or holds a line which is not a trace entry
+bool ReadTrace(const std::string &path, std::vector<TraceSolver> &solvers,
+               std::vector<TraceQuery> &queries);
+
+// Run a recorded query on solver again, with the limits it was recorded
+// with, and store its result like the trace does. Returns false if the query
+// is unknown.
+bool ReplayQuery(Solver &solver, const TraceQuery &query,
+                 std::vector<int> &result);
@@ -2,39 +2,89 @@
 
 #include <cassert>
 #include <cstdint>
+#include <cstdlib>
 #include <cstring>
+#include <new>
+#include <string>
+
+#include "profiler.hpp"
+
+TranspositionTable::TranspositionTable(const size_t size,
+                                       const std::string &shared_name) {
+  assert(size > 0);
+  if (!shared_name.empty()) {
+    shared_table = SharedMemoryTable::Attach(shared_name, size, shared_error);
+  }
+  if (!shared_table) {
+    memoi_table.reset(static_cast<Entry *>(std::calloc(size, sizeof(Entry))));
+    if (!memoi_table) {
+      throw std::bad_alloc();
+    }
+    table_size = size;
+  }
+}
 
 void TranspositionTable::Reset() {
-  std::memset(memoi_table.data(), 0, memoi_table.size() * sizeof(Entry));
+  // bounds in a shared table stay true and other processes rely on them, so
+  // only the private table is ever cleared
+  if (memoi_table && ++generation == 0) {
+    // the generations wrapped around, old entries could pass for new ones
+    std::memset(memoi_table.get(), 0, table_size * sizeof(Entry));
+    generation = 1;
+  }
   entries_count = 0;
   collisions = 0;
 }
 
-void TranspositionTable::Put(const uint64_t key, const uint8_t val) {
-  if (entries_count >= static_cast<int>(memoi_table.size() / 2)) {
+void TranspositionTable::Put(const uint64_t key, const uint8_t val,
+                             const uint8_t move) {
+  C4_PROFILE_SCOPE(kTablePut);
+  if (shared_table) {
+    shared_table->Put(key, val, move);
+    return;
+  }
+  stats.puts++;
+  if (entries_count >= static_cast<int>(table_size / 2)) {
     Reset();
   }
   size_t idx = index(key);
-  while (memoi_table[idx].key != 0 && memoi_table[idx].key != key) {
-    idx = (idx + 1) % memoi_table.size();
+  while (isUsed(memoi_table[idx]) && memoi_table[idx].key != key) {
+    idx = (idx + 1) % table_size;
     collisions++;
   }
-  if (memoi_table[idx].key == 0) {
+  if (!isUsed(memoi_table[idx])) {
     entries_count++;
+    memoi_table[idx] = {key, val, move, generation};
+  } else if (val == 0) {
+    memoi_table[idx].move = move;
+  } else {
+    memoi_table[idx] = {key, val, move, generation};
   }
-  memoi_table[idx] = {key, val};
 }
 
-uint8_t TranspositionTable::Get(const uint64_t key) const {
-  if (opening_table.contains(key)) {
-    return opening_table.at(key);
+uint8_t TranspositionTable::Get(const uint64_t key, uint8_t &move) const {
+  C4_PROFILE_SCOPE(kTableGet);
+  move = 0;
+  if (shared_table) {
+    return shared_table->Get(key, move);
   }
   size_t idx = index(key);
-  while (memoi_table[idx].key != 0) {
+  while (isUsed(memoi_table[idx])) {
     if (memoi_table[idx].key == key) {
+      stats.hits++;
+      move = memoi_table[idx].move;
       return memoi_table[idx].val;
     }
-    idx = (idx + 1) % memoi_table.size();
+    idx = (idx + 1) % table_size;
   }
+  stats.misses++;
   return 0;
+}
+
+TableStats TranspositionTable::GetStats() const {
+  if (shared_table) {
+    const auto &shared_stats = shared_table->GetLocalStats();
+    return {shared_stats.hits, shared_stats.misses, shared_stats.puts};
+  }
+  return stats;
 }
\ No newline at end of file
@@ -2,47 +2,107 @@
 
 #include <cassert>
 #include <cstdint>
-#include <vector>
+#include <cstdlib>
+#include <memory>
+#include <string>
 
-#include "robin/robin_hood.h"
+#include "shared_table.hpp"
+
+// Lookups and stores of a table since it was created
+struct TableStats {
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t puts = 0;
+};
 
 class TranspositionTable {
  public:
-  explicit TranspositionTable(const size_t size) : memoi_table(size) {
-    assert(size > 0);
-    constexpr int OPENING_TABLE_SIZE = 10e6;
-    opening_table.reserve(OPENING_TABLE_SIZE);
-  }
+  // With a shared_name, the memoization table is the shared memory table of
+  // that name, see SharedMemoryTable. If attaching fails, the table falls
+  // back to a private one and GetSharedError tells why.
+  explicit TranspositionTable(size_t size,
+                              const std::string &shared_name = "");
 
+  // Forget every entry in constant time, by starting a new generation of
+  // entries
   void Reset();
 
-  void Put(uint64_t key, uint8_t val);
+  // Store the upper bound val of a position, and optionally its best move as
+  // column + 1. A val of 0 only records the move, keeping the stored bound.
+  void Put(uint64_t key, uint8_t val, uint8_t move = 0);
+
+  uint8_t Get(uint64_t key) const {
+    uint8_t move = 0;
+    return Get(key, move);
+  }
 
-  uint8_t Get(uint64_t key) const;
+  // Same as Get, and also retrieve the stored move (column + 1, 0 if none)
+  uint8_t Get(uint64_t key, uint8_t &move) const;
 
-  void PutOpeningMove(uint64_t key, uint8_t score) {
-    opening_table.emplace(key, score);
+  // Start loading the slot of key into the CPU caches, so that a Get issued
+  // a little later does not wait on memory
+  void Prefetch(const uint64_t key) const {
+    if (shared_table) {
+      shared_table->Prefetch(key);
+    } else {
+      __builtin_prefetch(&memoi_table.get()[index(key)]);
+    }
   }
 
   int GetMemoiEntriesCount() const { return entries_count; }
 
+  uint16_t GetGeneration() const { return generation; }
+
   int GetNumOfCollisions() const { return collisions; }
 
-  size_t GetMemoiTableSize() const { return memoi_table.size(); }
+  size_t GetMemoiTableSize() const {
+    return shared_table ? shared_table->GetEntryCount() : table_size;
+  }
+
+  // lookups of this solver only when the table is shared
+  TableStats GetStats() const;
 
-  size_t GetOpeningTableSize() const { return opening_table.size(); }
+  bool IsShared() const { return shared_table != nullptr; }
+
+  const SharedMemoryTable *GetSharedTable() const {
+    return shared_table.get();
+  }
+
+  const std::string &GetSharedError() const { return shared_error; }
 
  private:
+  // An entry only exists in the generation it was stored in, the entries of
+  // the previous generations are empty slots. The generation fits in the
+  // padding of the entry, which stays 16 bytes.
   struct Entry {
     uint64_t key;
     uint8_t val;
+    uint8_t move;
+    uint16_t generation;
+  };
+
+  struct FreeDeleter {
+    void operator()(Entry *entries) const { std::free(entries); }
   };
 
-  robin_hood::unordered_flat_map<uint64_t, uint8_t> opening_table;
-  std::vector<Entry> memoi_table;
+  // allocated with calloc, so that the pages are only zeroed by the kernel
+  // when first touched instead of all at once by the constructor
+  std::unique_ptr<Entry[], FreeDeleter> memoi_table;
+  size_t table_size = 0;  // 0 for a shared table
+  std::unique_ptr<SharedMemoryTable> shared_table;
+  std::string shared_error;
 
-  size_t index(const uint64_t key) const { return key % memoi_table.size(); }
+  // of the entries stored since the last Reset, never 0 so that the zeroed
+  // slots of a new table are empty
+  uint16_t generation = 1;
+
+  size_t index(const uint64_t key) const { return key % table_size; }
+
+  bool isUsed(const Entry &entry) const {
+    return entry.generation == generation;
+  }
 
   int entries_count = 0;
   int collisions = 0;
+  mutable TableStats stats;
 };
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "zugzwang_rules.hpp"
+
+#include <array>
+#include <cstdint>
+
+#include "position.hpp"
+
+namespace {
+constexpr int GROUP_COUNT = 69;  // alignments of 4 cells on a 7x6 board
+
+constexpr uint64_t cell(const int col, const int row) {
+  return UINT64_C(1) << (col * (Position::HEIGHT + 1) + row);
+}
+
+constexpr std::array<uint64_t, GROUP_COUNT> makeGroups() {
+  std::array<uint64_t, GROUP_COUNT> groups{};
+  constexpr std::array<std::array<int, 2>, 4> DIRECTIONS = {
+      {{1, 0}, {0, 1}, {1, 1}, {1, -1}}};
+  size_t count = 0;
+  for (const auto &direction : DIRECTIONS) {
+    for (int col = 0; col < Position::WIDTH; col++) {
+      for (int row = 0; row < Position::HEIGHT; row++) {
+        const int last_col = col + 3 * direction[0];
+        const int last_row = row + 3 * direction[1];
+        if (last_col >= Position::WIDTH || last_row < 0 ||
+            last_row >= Position::HEIGHT) {
+          continue;
+        }
+        uint64_t group = 0;
+        for (int i = 0; i < 4; i++) {
+          group |= cell(col + i * direction[0], row + i * direction[1]);
+        }
+        groups[count++] = group;
+      }
+    }
+  }
+  return groups;
+}
+
+constexpr std::array<uint64_t, GROUP_COUNT> GROUPS = makeGroups();
+
+// Whether the bases not in used can be paired into baseinverses so that
+// every one of the open groups holds both cells of a pair
+bool pairBases(const std::array<uint64_t, Position::WIDTH> &bases,
+               const int base_count, const unsigned used,
+               const std::array<uint64_t, GROUP_COUNT> &open,
+               const int open_count) {
+  if (open_count == 0) {
+    return true;
+  }
+  int first = 0;
+  while (first < base_count && (used & (1U << first)) != 0) {
+    first++;
+  }
+  if (first == base_count) {
+    return false;
+  }
+  for (int other = first + 1; other < base_count; other++) {
+    if ((used & (1U << other)) != 0) {
+      continue;
+    }
+    const uint64_t pair = bases[first] | bases[other];
+    std::array<uint64_t, GROUP_COUNT> left{};
+    int left_count = 0;
+    for (int i = 0; i < open_count; i++) {
+      if ((open[i] & pair) != pair) {
+        left[left_count++] = open[i];
+      }
+    }
+    if (pairBases(bases, base_count, used | 1U << first | 1U << other, left,
+                  left_count)) {
+      return true;
+    }
+  }
+  return false;
+}
+}  // namespace
+
+bool ProvesNoWin(const Position &P) {
+  if ((Position::WIDTH * Position::HEIGHT - P.NumMoves()) % 2 != 0) {
+    return false;  // the pairs cannot cover an odd number of cells
+  }
+  const uint64_t mask = P.GetMask();
+  const uint64_t follower = mask ^ P.GetCurrentPosition();
+
+  // upper cells of the claimeven pairs, and lowest empty cell of the columns
+  // with an odd number of empty cells
+  uint64_t claimed = 0;
+  std::array<uint64_t, Position::WIDTH> bases{};
+  int base_count = 0;
+  for (int col = 0; col < Position::WIDTH; col++) {
+    const int height = __builtin_popcountll(mask & Position::ColumnMask(col));
+    int row = height;
+    if ((Position::HEIGHT - height) % 2 != 0) {
+      bases[base_count++] = cell(col, row++);
+    }
+    for (row++; row < Position::HEIGHT; row += 2) {
+      claimed |= cell(col, row);
+    }
+  }
+
+  // alignments the player to move could still complete
+  std::array<uint64_t, GROUP_COUNT> open{};
+  int open_count = 0;
+  for (const uint64_t group : GROUPS) {
+    if ((group & (follower | claimed)) == 0) {
+      open[open_count++] = group;
+    }
+  }
+  return pairBases(bases, base_count, 0, open, open_count);
+}
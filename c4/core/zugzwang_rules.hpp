@@ -0,0 +1,24 @@
+#pragma once
+
+#include "position.hpp"
+
+/**
+ * Knowledge-based proof, after the rules of Allis' Victor, that the player
+ * to move cannot win. The other player controls the zugzwang with a
+ * follow-up strategy: the empty cells are split into pairs and every move of
+ * the player to move is answered with the other cell of its pair, so that
+ * the player to move gets exactly one cell of every pair.
+ * - claimeven: a column with an even number of empty cells is split into
+ *   pairs of a cell and the cell above it. The upper cells go to the
+ *   follower, so an alignment through one of them is refuted.
+ * - baseinverse: the lowest empty cells of two columns with an odd number
+ *   of empty cells form a pair, the rest of the columns are claimeven
+ *   pairs. An alignment through both cells of the pair is refuted.
+ * - vertical: an alignment through both cells of a claimeven pair is
+ *   refuted, which is part of the claimeven refutation here.
+ * The proof holds when some pairing of the odd columns refutes every
+ * alignment the player to move could still complete. It only applies with an
+ * even number of empty cells, so for the first player to move, and proves in
+ * well under a microsecond what Negamax needs a full search for.
+ */
+bool ProvesNoWin(const Position &P);
@@ -0,0 +1,164 @@
+#include "c4.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <new>
+
+#include "core/book_source.hpp"
+#include "core/opening_book.hpp"
+#include "core/position.hpp"
+#include "core/solver.hpp"
+
+static_assert(C4_WIDTH == Position::WIDTH && C4_HEIGHT == Position::HEIGHT,
+              "c4.h does not match the board size of the solver");
+static_assert(sizeof(c4_position) == 2 * sizeof(uint64_t),
+              "c4_position must match the binary position records");
+
+struct c4_book {
+  std::shared_ptr<BookSource> source;
+};
+
+struct c4_solver {
+  std::mutex mutex;
+  Solver solver;
+
+  explicit c4_solver(const SolverConfig &config) : solver(config) {}
+};
+
+namespace {
+// Score of every playable column of P, the C ABI counterpart of
+// Solver::ScoreColumns writing straight into the caller's array
+void scoreColumns(Solver &solver, const Position &P, int8_t *scores) {
+  for (int col = 0; col < Position::WIDTH; col++) {
+    if (!P.CanPlay(col)) {
+      scores[col] = C4_SCORE_NONE;
+    } else if (P.IsWinningMove(col)) {
+      scores[col] = static_cast<int8_t>(
+          (Position::WIDTH * Position::HEIGHT + 1 - P.NumMoves()) / 2);
+    } else {
+      Position P2(P);
+      P2.PlayCol(col);
+      scores[col] = static_cast<int8_t>(-solver.Solve(P2));
+    }
+  }
+}
+}  // namespace
+
+uint32_t c4_abi_version(void) { return C4_ABI_VERSION; }
+
+c4_book *c4_book_load(const char *opening_book_path,
+                      const char *warmup_book_path) {
+  try {
+    return new c4_book{std::make_shared<BookSource>(
+        opening_book_path ? opening_book_path : "",
+        warmup_book_path ? warmup_book_path : "")};
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void c4_book_destroy(c4_book *book) { delete book; }
+
+size_t c4_book_size(const c4_book *book) {
+  return book != nullptr ? book->source->Get()->Size() : 0;
+}
+
+c4_status c4_book_reload(c4_book *book) {
+  if (book == nullptr) {
+    return C4_ERROR_INVALID_ARGUMENT;
+  }
+  try {
+    return book->source->ReloadNow().loaded ? C4_OK
+                                            : C4_ERROR_BOOK_UNREADABLE;
+  } catch (const std::bad_alloc &) {
+    return C4_ERROR_OUT_OF_MEMORY;
+  }
+}
+
+c4_solver *c4_solver_create(const size_t table_size) {
+  SolverConfig config;
+  if (table_size != 0) {
+    config.table_size = table_size;
+  }
+  try {
+    return new c4_solver(config);
+  } catch (const std::bad_alloc &) {
+    return nullptr;
+  }
+}
+
+void c4_solver_destroy(c4_solver *solver) { delete solver; }
+
+c4_status c4_solver_set_book(c4_solver *solver, const c4_book *book) {
+  if (solver == nullptr) {
+    return C4_ERROR_INVALID_ARGUMENT;
+  }
+  const std::lock_guard<std::mutex> lock(solver->mutex);
+  solver->solver.SetBookSource(book != nullptr ? book->source : nullptr);
+  return C4_OK;
+}
+
+c4_status c4_solver_reset(c4_solver *solver) {
+  if (solver == nullptr) {
+    return C4_ERROR_INVALID_ARGUMENT;
+  }
+  const std::lock_guard<std::mutex> lock(solver->mutex);
+  solver->solver.Reset();
+  return C4_OK;
+}
+
+uint64_t c4_solver_node_count(c4_solver *solver) {
+  if (solver == nullptr) {
+    return 0;
+  }
+  const std::lock_guard<std::mutex> lock(solver->mutex);
+  return solver->solver.GetNodeCount();
+}
+
+c4_status c4_solve(c4_solver *solver, const c4_position *positions,
+                   const size_t count, int8_t *scores) {
+  if (solver == nullptr || (count != 0 && (positions == nullptr ||
+                                           scores == nullptr))) {
+    return C4_ERROR_INVALID_ARGUMENT;
+  }
+  const std::lock_guard<std::mutex> lock(solver->mutex);
+  c4_status status = C4_OK;
+  for (size_t i = 0; i < count; i++) {
+    const uint64_t position = positions[i].current_position;
+    const uint64_t stones = positions[i].mask;
+    if (!Position::IsValid(position, stones)) {
+      scores[i] = C4_SCORE_NONE;
+      status = C4_ERROR_INVALID_POSITION;
+      continue;
+    }
+    scores[i] =
+        static_cast<int8_t>(solver->solver.Solve(Position(position, stones)));
+  }
+  return status;
+}
+
+c4_status c4_score_columns(c4_solver *solver, const c4_position *positions,
+                           const size_t count, int8_t *scores) {
+  if (solver == nullptr || (count != 0 && (positions == nullptr ||
+                                           scores == nullptr))) {
+    return C4_ERROR_INVALID_ARGUMENT;
+  }
+  const std::lock_guard<std::mutex> lock(solver->mutex);
+  c4_status status = C4_OK;
+  for (size_t i = 0; i < count; i++) {
+    int8_t *position_scores = scores + i * Position::WIDTH;
+    const uint64_t position = positions[i].current_position;
+    const uint64_t stones = positions[i].mask;
+    if (!Position::IsValid(position, stones)) {
+      for (int col = 0; col < Position::WIDTH; col++) {
+        position_scores[col] = C4_SCORE_NONE;
+      }
+      status = C4_ERROR_INVALID_POSITION;
+      continue;
+    }
+    scoreColumns(solver->solver, Position(position, stones), position_scores);
+  }
+  return status;
+}
@@ -0,0 +1,112 @@
+/*
+ * C interface of the connect 4 solver, to embed it in other programs.
+ *
+ * Positions are passed as a pair of bitboards, the same layout as the
+ * records of binary position files: bit col * (C4_HEIGHT + 1) + row is the
+ * cell of a column and row counted from the bottom left, mask holds every
+ * stone and current_position the stones of the player to move.
+ *
+ * Every function taking a solver handle locks it, so a handle can be used
+ * from several threads; use one handle per thread to solve in parallel.
+ */
+#ifndef C4_H
+#define C4_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+#ifdef C4_BUILDING_LIBRARY
+#define C4_API __declspec(dllexport)
+#else
+#define C4_API __declspec(dllimport)
+#endif
+#else
+#define C4_API __attribute__((visibility("default")))
+#endif
+
+/* bumped on every incompatible change of this interface */
+#define C4_ABI_VERSION 1
+
+#define C4_WIDTH 7
+#define C4_HEIGHT 6
+
+/* score written for unplayable columns and invalid positions */
+#define C4_SCORE_NONE (-128)
+
+typedef struct c4_solver c4_solver;
+typedef struct c4_book c4_book;
+
+typedef struct c4_position {
+  uint64_t mask;
+  uint64_t current_position;
+} c4_position;
+
+typedef enum c4_status {
+  C4_OK = 0,
+  C4_ERROR_INVALID_ARGUMENT = 1,
+  /* at least one position was not a reachable stone layout or already had
+     an alignment of 4, its scores are C4_SCORE_NONE and the other positions
+     were solved */
+  C4_ERROR_INVALID_POSITION = 2,
+  C4_ERROR_OUT_OF_MEMORY = 3,
+  /* a book file could not be read, the previous book stays in use */
+  C4_ERROR_BOOK_UNREADABLE = 4
+} c4_status;
+
+/* C4_ABI_VERSION of the loaded library */
+C4_API uint32_t c4_abi_version(void);
+
+/* Load the opening book then the warmup book, either path may be NULL. A
+   missing file loads nothing. Returns NULL when out of memory. A book is
+   read-only and can be shared by any number of solvers. */
+C4_API c4_book *c4_book_load(const char *opening_book_path,
+                             const char *warmup_book_path);
+
+/* Solvers using the book keep it alive after this call */
+C4_API void c4_book_destroy(c4_book *book);
+
+C4_API size_t c4_book_size(const c4_book *book);
+
+/* Load the book files again and swap the result in. Solvers using book pick
+   it up at the start of their next call, calls already running finish with
+   the previous book. Safe to call while other threads use the solvers.
+   Returns C4_ERROR_BOOK_UNREADABLE, keeping the previous book, when a path
+   given to c4_book_load cannot be read. */
+C4_API c4_status c4_book_reload(c4_book *book);
+
+/* Create a solver with a memoization table of table_size entries, 0 for
+   the default size. Returns NULL when out of memory. */
+C4_API c4_solver *c4_solver_create(size_t table_size);
+
+C4_API void c4_solver_destroy(c4_solver *solver);
+
+/* Use book, or no book when book is NULL */
+C4_API c4_status c4_solver_set_book(c4_solver *solver, const c4_book *book);
+
+/* Clear the memoization table and the node count */
+C4_API c4_status c4_solver_reset(c4_solver *solver);
+
+/* Nodes explored since the solver was created or reset */
+C4_API uint64_t c4_solver_node_count(c4_solver *solver);
+
+/* Write the score of positions[i] to scores[i] for i < count. A positive
+   score means the player to move wins, the larger the sooner. */
+C4_API c4_status c4_solve(c4_solver *solver, const c4_position *positions,
+                          size_t count, int8_t *scores);
+
+/* Write the score of playing column c in positions[i] to
+   scores[i * C4_WIDTH + c], C4_SCORE_NONE for full columns. */
+C4_API c4_status c4_score_columns(c4_solver *solver,
+                                  const c4_position *positions, size_t count,
+                                  int8_t *scores);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* C4_H */
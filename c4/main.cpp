@@ -1,8 +1,15 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <string>
+#include <thread>
 
 #include "app/cli/app.hpp"
+#include "core/solved_log.hpp"
+#include "core/trace.hpp"
 #include "cxxopts/cxxopts.hpp"
 
 static cxxopts::Options initOptions(
@@ -21,11 +28,58 @@ static cxxopts::Options initOptions(
       "warmup-book", "Specify a warmup book.",
       cxxopts::value<std::string>()->default_value("data/warmup.book"));
 
+  options.add_options("SOLVER")(
+      "shared-tt",
+      "Share the memoization table with the other c4 processes using this "
+      "shared memory name.",
+      cxxopts::value<std::string>()->default_value(""))(
+      "trace", "Record every solver query into this trace file.",
+      cxxopts::value<std::string>()->default_value(""))(
+      "solved-log",
+      "Append every solved position to this log, merged into --solved-book "
+      "every --compact-interval seconds and at exit.",
+      cxxopts::value<std::string>()->default_value(""))(
+      "solved-book",
+      "Book the solved log is merged into, pass the warmup book to answer "
+      "the solved positions from the book at once.",
+      cxxopts::value<std::string>()->default_value("data/solved.book"))(
+      "compact-interval",
+      "Seconds between two merges of the solved log into the solved book.",
+      cxxopts::value<int64_t>()->default_value("60"))(
+      "solver-seed",
+      "Seed of the choice among equally good moves, 0 for a random seed.",
+      cxxopts::value<uint32_t>()->default_value("0"));
+
+  options.add_options("ANALYSIS")(
+      "compare",
+      "With --analyze-game, also solve every position of the game on its own "
+      "and report the time saved.")(
+      "details",
+      "With --analyze or --analyze-game, also print the principal variation, "
+      "solving every position along it, and the shared table statistics.");
+
+  options.add_options("ARENA")(
+      "games", "Number of arena games.",
+      cxxopts::value<int>()->default_value("100"))(
+      "threads", "Number of arena threads.",
+      cxxopts::value<unsigned int>()->default_value(
+          std::to_string(std::max(1U, std::thread::hardware_concurrency()))))(
+      "random-plies", "Random moves opening every arena game.",
+      cxxopts::value<int>()->default_value("4"))(
+      "seed", "Seed of the arena openings.",
+      cxxopts::value<uint32_t>()->default_value("1"))(
+      "engine-a",
+      "Settings of the first engine, e.g. "
+      "table=1048583,endgame=12,weak,budget=50",
+      cxxopts::value<std::string>()->default_value(""))(
+      "engine-b", "Settings of the second engine.",
+      cxxopts::value<std::string>()->default_value(""));
+
   options.parse_positional({"opening-book", "warmup-book"});
 
   constexpr int OPTION_LENGTH = 100;
   options.show_positional_help()
-      .custom_help("MODE")
+      .custom_help("MODE [OPTION...]")
       .positional_help("[BOOK...]")
       .set_width(OPTION_LENGTH);
 
@@ -36,10 +90,13 @@ static void parseArgs(const int argc, const char** argv) {
   // Add new options here
   const std::map<std::string, std::string> option_list = {
       {"a,analyze", "Analyze a game state"},
+      {"g,analyze-game",
+       "Analyze every move of a game, solving from the last move back"},
       {"p,play", "Play a game versus bot"},
       {"b,botgame", "Watch a game between 2 bots"},
       {"h,help", "Print this help menu"},
-      {"t,training", "Start a training session"}};
+      {"t,training", "Start a training session"},
+      {"r,arena", "Run many bot games in parallel and report statistics"}};
 
   auto options = initOptions(option_list);
 
@@ -69,14 +126,43 @@ static void parseArgs(const int argc, const char** argv) {
   const auto opening_book = result["opening-book"].as<std::string>();
   const auto warmup_book = result["warmup-book"].as<std::string>();
 
-  cli::App cli_app(opening_book, warmup_book);
+  SolverConfig config;
+  config.shared_table = result["shared-tt"].as<std::string>();
+  config.seed = result["solver-seed"].as<uint32_t>();
+  const auto trace_path = result["trace"].as<std::string>();
+  if (!trace_path.empty()) {
+    config.trace = std::make_shared<TraceRecorder>(trace_path);
+    if (!config.trace->IsOpen()) {
+      std::cerr << "Cannot write the trace " << trace_path << '\n';
+      return;
+    }
+  }
+
+  const auto solved_log_path = result["solved-log"].as<std::string>();
+  if (!solved_log_path.empty()) {
+    config.solved_log = std::make_shared<SolvedLog>(solved_log_path);
+    if (!config.solved_log->IsOpen()) {
+      std::cerr << "Cannot write the solved log " << solved_log_path << '\n';
+      return;
+    }
+  }
+
+  cli::App cli_app(opening_book, warmup_book, config);
+  cli_app.SetCompaction(
+      result["solved-book"].as<std::string>(),
+      std::chrono::seconds(
+          std::max<int64_t>(1, result["compact-interval"].as<int64_t>())));
 
   // Specify actions for new options here
   for (const auto& [option, description] : option_list) {
     const std::string option_name = option.substr(option.find(',') + 1);
     if (result[option_name].as<bool>()) {
       if (option_name == "analyze") {
-        cli_app.Analyze();
+        cli_app.Analyze(result["details"].as<bool>());
+      }
+      if (option_name == "analyze-game") {
+        cli_app.AnalyzeGame(result["compare"].as<bool>(),
+                            result["details"].as<bool>());
       }
       if (option_name == "botgame") {
         cli_app.StartBotGame();
@@ -87,6 +173,25 @@ static void parseArgs(const int argc, const char** argv) {
       if (option_name == "training") {
         cli_app.StartTraining();
       }
+      if (option_name == "arena") {
+        cli::ArenaSettings settings;
+        settings.games = result["games"].as<int>();
+        settings.threads = std::max(1U, result["threads"].as<unsigned int>());
+        settings.random_plies = result["random-plies"].as<int>();
+        settings.seed = result["seed"].as<uint32_t>();
+        if (!cli::ParseEngineSettings(result["engine-a"].as<std::string>(),
+                                      settings.engines[0]) ||
+            !cli::ParseEngineSettings(result["engine-b"].as<std::string>(),
+                                      settings.engines[1])) {
+          return;
+        }
+        for (auto &engine : settings.engines) {
+          engine.config.seed = config.seed;
+          engine.config.trace = config.trace;
+          engine.config.solved_log = config.solved_log;
+        }
+        cli_app.StartArena(settings);
+      }
     }
   }
 }
@@ -0,0 +1,317 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/cost_model.hpp"
+#include "core/opening_book.hpp"
+#include "core/position.hpp"
+#include "core/position_io.hpp"
+#include "core/solved_log.hpp"
+#include "core/solver.hpp"
+#include "cxxopts/cxxopts.hpp"
+
+namespace {
+struct BatchOptions {
+  std::string opening_book;
+  std::string warmup_book;
+  unsigned int threads = 1;
+  // per position, a position stopped early is output as its bounds
+  SearchLimits limits;
+  // solve the positions predicted to be the slowest first
+  bool longest_first = true;
+  // nodes of the search probing every position before ordering, 0 for none
+  uint64_t probe_nodes = 0;
+  CostModel cost_model;
+  // every solved position is appended to it, see c4_compact
+  std::shared_ptr<SolvedLog> solved_log;
+};
+
+struct BatchStats {
+  uint64_t nodes = 0;
+  size_t probe_solved = 0;
+  // time between the first and the last thread running out of positions
+  double tail_ms = 0;
+};
+
+// Run work(solver, i) for i < count on every thread, each thread owning one
+// of solvers and pulling the next index from a shared counter, so that a
+// slow index only holds up its own thread. Returns, in milliseconds, the time
+// between the first and the last thread running out of indexes.
+template <typename Work>
+double runWorkers(std::vector<std::unique_ptr<Solver>> &solvers,
+                  const size_t count, const Work &work) {
+  using cl = std::chrono::steady_clock;
+  std::atomic<size_t> next_index{0};
+  std::vector<cl::time_point> finished(solvers.size());
+
+  std::vector<std::thread> threads;
+  for (size_t t = 0; t < solvers.size(); t++) {
+    threads.emplace_back([&, t]() {
+      for (size_t i = next_index++; i < count; i = next_index++) {
+        work(*solvers[t], i);
+      }
+      finished[t] = cl::now();
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+  const auto [first, last] =
+      std::minmax_element(finished.begin(), finished.end());
+  const std::chrono::duration<double, std::milli> tail = *last - *first;
+  return tail.count();
+}
+
+// Solve every position, slowest predicted first unless the options keep the
+// input order. Fills, for every position, its result and the features the
+// cost model saw, for calibration.
+void solveAll(const std::vector<Position> &positions,
+              std::vector<SolveResult> &results,
+              std::vector<CostModel::Features> &features,
+              const BatchOptions &batch_options, BatchStats &stats) {
+  const auto book =
+      OpeningBook::Load(batch_options.opening_book, batch_options.warmup_book);
+  std::vector<std::unique_ptr<Solver>> solvers;
+  SolverConfig config;
+  config.solved_log = batch_options.solved_log;
+  for (unsigned int i = 0; i < batch_options.threads; i++) {
+    solvers.push_back(std::make_unique<Solver>(config));
+    solvers.back()->SetOpeningBook(book);
+  }
+
+  std::vector<double> costs(positions.size());
+  std::vector<char> solved(positions.size(), 0);
+  if (batch_options.longest_first) {
+    SearchLimits probe_limits = batch_options.limits;
+    probe_limits.max_nodes = batch_options.probe_nodes;
+    runWorkers(solvers, positions.size(), [&](Solver &solver, const size_t i) {
+      features[i] = CostModel::Extract(positions[i], book.get());
+      costs[i] = batch_options.cost_model.Predict(positions[i], book.get());
+      if (batch_options.probe_nodes != 0 && costs[i] != 0) {
+        // the probe both measures the position and solves the easy ones
+        results[i] = solver.Solve(positions[i], probe_limits);
+        solved[i] = !results[i].stopped;
+        costs[i] = std::max(costs[i], std::log2(static_cast<double>(
+                                          batch_options.probe_nodes)));
+      }
+    });
+  }
+
+  const std::vector<size_t> order = OrderLongestFirst(costs);
+  std::atomic<size_t> probe_solved{0};
+  stats.tail_ms =
+      runWorkers(solvers, order.size(), [&](Solver &solver, const size_t n) {
+        const size_t i = order[n];
+        if (solved[i]) {
+          probe_solved++;
+          return;
+        }
+        const uint64_t probe_nodes = results[i].nodes;
+        results[i] = solver.Solve(positions[i], batch_options.limits);
+        results[i].nodes += probe_nodes;
+      });
+  stats.probe_solved = probe_solved;
+
+  stats.nodes = 0;
+  for (const auto &solver : solvers) {
+    stats.nodes += solver->GetNodeCount();
+  }
+}
+
+// Fit the cost model to the node counts of the positions solved by a search
+// and write it to path, reporting how far its predictions are off
+bool calibrate(const std::vector<Position> &positions,
+               const std::vector<SolveResult> &results,
+               const std::vector<CostModel::Features> &features,
+               CostModel cost_model, const std::string &path) {
+  std::vector<CostModel::Features> samples;
+  std::vector<uint64_t> nodes;
+  for (size_t i = 0; i < positions.size(); i++) {
+    if (results[i].IsExact() && results[i].nodes > 1 &&
+        cost_model.Predict(features[i]) != 0) {
+      samples.push_back(features[i]);
+      nodes.push_back(results[i].nodes);
+    }
+  }
+
+  auto meanError = [&samples, &nodes](const CostModel &model) {
+    double error = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+      error += std::abs(model.Predict(samples[i]) -
+                        std::log2(static_cast<double>(nodes[i]) + 1));
+    }
+    return error / static_cast<double>(std::max<size_t>(1, samples.size()));
+  };
+
+  const double error_before = meanError(cost_model);
+  if (!cost_model.Fit(samples, nodes)) {
+    std::cerr << "Cannot calibrate the cost model from " << samples.size()
+              << " solved positions.\n";
+    return false;
+  }
+  if (!cost_model.Save(path)) {
+    std::cerr << "Cannot write " << path << '\n';
+    return false;
+  }
+  std::cerr << "Calibrated the cost model on " << samples.size()
+            << " positions, mean log2 node count error " << error_before
+            << " -> " << meanError(cost_model) << ", written to " << path
+            << ".\n";
+  return true;
+}
+}  // namespace
+
+int main(const int argc, const char **argv) {
+  cxxopts::Options options("c4_batch",
+                           "Score every position of a position file");
+  options.add_options()("input", "Text or binary position file",
+                        cxxopts::value<std::string>())(
+      "o,output",
+      "Write one score per line to this file instead of stdout, positions "
+      "stopped by a limit are written as min..max",
+      cxxopts::value<std::string>()->default_value(""))(
+      "time-limit", "Milliseconds allowed per position, 0 for no limit",
+      cxxopts::value<int64_t>()->default_value("0"))(
+      "node-limit", "Nodes allowed per position, 0 for no limit",
+      cxxopts::value<uint64_t>()->default_value("0"))(
+      "j,threads", "Number of solver threads",
+      cxxopts::value<unsigned int>()->default_value(
+          std::to_string(std::max(1U, std::thread::hardware_concurrency()))))(
+      "order",
+      "Order of the positions: longest, predicted slowest first, or input",
+      cxxopts::value<std::string>()->default_value("longest"))(
+      "probe-nodes",
+      "Probe every position with a search of this many nodes to predict its "
+      "cost, 0 for no probe",
+      cxxopts::value<uint64_t>()->default_value("0"))(
+      "cost-model", "Cost model weights written by --calibrate",
+      cxxopts::value<std::string>()->default_value(""))(
+      "calibrate",
+      "Fit the cost model to the node counts of this batch and write it to "
+      "this file",
+      cxxopts::value<std::string>()->default_value(""))(
+      "solved-log",
+      "Append every solved position to this log, to merge into a book with "
+      "c4_compact",
+      cxxopts::value<std::string>()->default_value(""))(
+      "opening-book", "Specify an opening book.",
+      cxxopts::value<std::string>()->default_value("data/opening.book"))(
+      "warmup-book", "Specify a warmup book.",
+      cxxopts::value<std::string>()->default_value("data/warmup.book"))(
+      "h,help", "Print this help menu");
+  options.parse_positional({"input"});
+  options.positional_help("INPUT");
+
+  cxxopts::ParseResult result;
+  try {
+    result = options.parse(argc, argv);
+  } catch (cxxopts::exceptions::exception &e) {
+    std::cerr << e.what() << '\n' << options.help();
+    return 1;
+  }
+
+  if (result.contains("help") || !result.contains("input")) {
+    std::cout << options.help();
+    return 0;
+  }
+
+  BatchOptions batch_options;
+  batch_options.opening_book = result["opening-book"].as<std::string>();
+  batch_options.warmup_book = result["warmup-book"].as<std::string>();
+  batch_options.threads =
+      std::max(1U, result["threads"].as<unsigned int>());
+  batch_options.limits.max_time =
+      std::chrono::milliseconds(result["time-limit"].as<int64_t>());
+  batch_options.limits.max_nodes = result["node-limit"].as<uint64_t>();
+  const auto order = result["order"].as<std::string>();
+  if (order != "longest" && order != "input") {
+    std::cerr << "Unknown order: " << order << '\n';
+    return 1;
+  }
+  batch_options.longest_first = order == "longest";
+  batch_options.probe_nodes = result["probe-nodes"].as<uint64_t>();
+  const auto cost_model_path = result["cost-model"].as<std::string>();
+  if (!cost_model_path.empty() &&
+      !batch_options.cost_model.Load(cost_model_path)) {
+    std::cerr << "Cannot read the cost model " << cost_model_path << '\n';
+    return 1;
+  }
+  const auto calibration_path = result["calibrate"].as<std::string>();
+  const auto solved_log_path = result["solved-log"].as<std::string>();
+  if (!solved_log_path.empty()) {
+    batch_options.solved_log = std::make_shared<SolvedLog>(solved_log_path);
+    if (!batch_options.solved_log->IsOpen()) {
+      std::cerr << "Cannot write the solved log " << solved_log_path << '\n';
+      return 1;
+    }
+  }
+
+  using cl = std::chrono::high_resolution_clock;
+  const auto load_start = cl::now();
+  std::vector<Position> positions;
+  if (!LoadPositions(result["input"].as<std::string>(), positions)) {
+    std::cerr << "Cannot read " << result["input"].as<std::string>() << '\n';
+    return 1;
+  }
+  const auto load_end = cl::now();
+
+  std::vector<SolveResult> results(positions.size());
+  std::vector<CostModel::Features> features(positions.size());
+  if (!calibration_path.empty()) {
+    // the features are otherwise only extracted to order the positions
+    batch_options.longest_first = true;
+  }
+  BatchStats stats;
+  solveAll(positions, results, features, batch_options, stats);
+  const auto solve_end = cl::now();
+
+  const auto output_path = result["output"].as<std::string>();
+  std::ofstream output_file;
+  if (!output_path.empty()) {
+    output_file.open(output_path);
+  }
+  std::ostream &output = output_path.empty() ? std::cout : output_file;
+  size_t stopped = 0;
+  for (const SolveResult &solve_result : results) {
+    if (solve_result.IsExact()) {
+      output << solve_result.min << '\n';
+    } else {
+      output << solve_result.min << ".." << solve_result.max << '\n';
+      stopped++;
+    }
+  }
+
+  const std::chrono::duration<double, std::milli> load_taken =
+      load_end - load_start;
+  const std::chrono::duration<double, std::milli> solve_taken =
+      solve_end - load_end;
+  std::cerr << "Loaded " << positions.size() << " positions in "
+            << load_taken.count() << " ms.\n"
+            << "Solved with " << batch_options.threads << " threads in "
+            << solve_taken.count() << " ms, " << stats.nodes << " nodes, "
+            << static_cast<double>(positions.size()) /
+                   (solve_taken.count() / 1000)
+            << " positions/s, last thread done " << stats.tail_ms
+            << " ms after the first.\n";
+  if (batch_options.probe_nodes != 0) {
+    std::cerr << stats.probe_solved << " positions solved by the probe.\n";
+  }
+  if (stopped != 0) {
+    std::cerr << stopped << " positions hit a limit before being solved.\n";
+  }
+  if (!calibration_path.empty() &&
+      !calibrate(positions, results, features, batch_options.cost_model,
+                 calibration_path)) {
+    return 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,513 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <new>
+#include <random>
+#include <sstream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+
+#include "core/opening_book.hpp"
+#include "core/position.hpp"
+#include "core/position_io.hpp"
+#include "core/solver.hpp"
+#include "cxxopts/cxxopts.hpp"
+
+namespace {
+// every heap allocation of the program, to check the query path makes none
+std::atomic<uint64_t> allocationCount{0};
+
+// Kept out of line: GCC would otherwise see free, inlined from a delete,
+// release a block it only knows as coming from operator new, and warn
+[[gnu::noinline]] void release(void *block) noexcept { std::free(block); }
+}  // namespace
+
+// Every form of the replaceable operator new and its matching delete is
+// defined here, on malloc and free, so none of them can mix with the
+// library's own
+void *operator new(const size_t size) {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  if (void *block = std::malloc(size != 0 ? size : 1)) {
+    return block;
+  }
+  throw std::bad_alloc();
+}
+
+void *operator new[](const size_t size) { return operator new(size); }
+
+void *operator new(const size_t size, const std::nothrow_t &) noexcept {
+  allocationCount.fetch_add(1, std::memory_order_relaxed);
+  return std::malloc(size != 0 ? size : 1);
+}
+
+void *operator new[](const size_t size, const std::nothrow_t &tag) noexcept {
+  return operator new(size, tag);
+}
+
+void operator delete(void *block) noexcept { release(block); }
+
+void operator delete[](void *block) noexcept { release(block); }
+
+void operator delete(void *block, size_t) noexcept { release(block); }
+
+void operator delete[](void *block, size_t) noexcept { release(block); }
+
+void operator delete(void *block, const std::nothrow_t &) noexcept {
+  release(block);
+}
+
+void operator delete[](void *block, const std::nothrow_t &) noexcept {
+  release(block);
+}
+
+namespace {
+struct Variant {
+  std::string description;
+  SolverConfig config;
+};
+
+// Add new solver configurations to compare here
+std::map<std::string, Variant> makeVariants() {
+  std::map<std::string, Variant> variants;
+
+  variants["default"] = {"Default solver configuration", SolverConfig{}};
+
+  SolverConfig generic;
+  generic.endgame_threshold = 0;
+  variants["generic"] = {"Generic Negamax down to the last cell", generic};
+
+  SolverConfig no_hash_move;
+  no_hash_move.hash_move = false;
+  variants["no-hash-move"] = {"MoveSorter ordering only, no hash move",
+                              no_hash_move};
+
+  SolverConfig parity;
+  parity.move_ordering = MoveOrdering::kThreatParity;
+  variants["parity"] = {"Moves ordered by threat parity", parity};
+
+  SolverConfig single_table;
+  single_table.near_leaf_table_size = 0;
+  variants["single-table"] = {"Every position in the main table, no near-leaf "
+                              "table",
+                              single_table};
+
+  SolverConfig forcing;
+  forcing.forcing_search = true;
+  variants["forcing"] = {"Forcing move search before every solve", forcing};
+
+  SolverConfig enhanced_cutoffs;
+  enhanced_cutoffs.enhanced_cutoffs = true;
+  variants["etc"] = {"Children looked up in the table before the search",
+                     enhanced_cutoffs};
+
+  SolverConfig zugzwang;
+  zugzwang.zugzwang_rules = true;
+  variants["zugzwang"] = {"Claimeven and baseinverse proofs before searching",
+                          zugzwang};
+
+  SolverConfig proof_number;
+  proof_number.backend = SearchBackend::kProofNumber;
+  variants["pn"] = {"Proof-number search for the null-window tests",
+                    proof_number};
+
+  return variants;
+}
+
+// Named position sets, as ranges of number of moves played
+const std::map<std::string, std::pair<int, int>> POSITION_SETS = {
+    {"endgame", {28, 32}}, {"midgame", {20, 24}}, {"opening", {14, 18}}};
+
+// Plays random non-losing moves from the empty board until reaching a ply
+// drawn from [min_ply, max_ply]. Games that end early are thrown away, so
+// every generated position is still undecided.
+std::vector<Position> generatePositions(const int count, const int min_ply,
+                                        const int max_ply,
+                                        const uint32_t seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<> ply_dist(min_ply, max_ply);
+  std::uniform_int_distribution<> col_dist(0, Position::WIDTH - 1);
+
+  std::vector<Position> positions;
+  while (static_cast<int>(positions.size()) < count) {
+    const int ply = ply_dist(gen);
+    Position pos;
+    while (pos.NumMoves() < ply && !pos.CanWinNext()) {
+      const uint64_t moves = pos.PossibleNonLosingMoves();
+      if (moves == 0) {
+        break;
+      }
+      int col = col_dist(gen);
+      while ((moves & Position::ColumnMask(col)) == 0) {
+        col = col_dist(gen);
+      }
+      pos.PlayCol(col);
+    }
+    if (pos.NumMoves() == ply && !pos.CanWinNext() &&
+        pos.PossibleNonLosingMoves() != 0) {
+      positions.push_back(pos);
+    }
+  }
+  return positions;
+}
+
+struct RunResult {
+  uint64_t nodes = 0;
+  double time_ms = 0;
+  double reset_ms = 0;  // of the Solver::Reset before every position
+  std::vector<int> scores;
+};
+
+RunResult run(Solver &solver, const std::vector<Position> &positions) {
+  using cl = std::chrono::high_resolution_clock;
+  RunResult result;
+  for (const auto &pos : positions) {
+    const auto reset_start = cl::now();
+    solver.Reset();
+    const std::chrono::duration<double, std::milli> reset_time =
+        cl::now() - reset_start;
+    result.reset_ms += reset_time.count();
+
+    const auto start = cl::now();
+    result.scores.push_back(solver.Solve(pos));
+    const auto end = cl::now();
+
+    const std::chrono::duration<double, std::milli> time_taken = end - start;
+    result.time_ms += time_taken.count();
+    result.nodes += solver.GetNodeCount();
+  }
+  return result;
+}
+
+// Runs every query of the solver API on each position, once to warm up and
+// once more counting the heap allocations, of which there should be none.
+// Returns the number of allocations and of queries counted.
+std::pair<uint64_t, uint64_t> countQueryAllocations(
+    Solver &solver, const std::vector<Position> &positions) {
+  SearchLimits limits;
+  limits.max_nodes = Solver::QUICK_SCORE_NODES;
+  uint64_t allocations = 0;
+  uint64_t queries = 0;
+  for (int pass = 0; pass < 2; pass++) {
+    const uint64_t before = allocationCount.load();
+    for (const auto &pos : positions) {
+      solver.Reset();
+      solver.Solve(pos);
+      solver.Solve(pos, limits);
+      solver.FindBestMove(pos);
+      solver.FindBestMove(pos, limits);
+      solver.Analyze(pos);
+      solver.ScoreColumns(pos);
+      queries += 6;
+    }
+    allocations = allocationCount.load() - before;
+  }
+  return {allocations, queries / 2};
+}
+
+std::string tableReport(const TableStats &stats) {
+  const uint64_t lookups = stats.hits + stats.misses;
+  std::ostringstream report;
+  report << stats.hits << " hits in " << lookups << " lookups";
+  if (lookups != 0) {
+    report << " (" << std::fixed << std::setprecision(1)
+           << 100.0 * static_cast<double>(stats.hits) /
+                  static_cast<double>(lookups)
+           << "%)";
+  }
+  report << ", " << stats.puts << " stores";
+  return report.str();
+}
+
+// bytes currently allocated on the heap, 0 where the C library cannot tell
+size_t heapInUse() {
+#ifdef __GLIBC__
+  const struct mallinfo2 info = mallinfo2();
+  return info.uordblks + info.hblkhd;  // small blocks and mmapped ones
+#else
+  return 0;
+#endif
+}
+
+// Start solver_count solvers either sharing one book or each loading its own
+// copy, and report the startup time and the heap they hold. The memoization
+// tables are kept tiny so that the books dominate.
+void compareBookSharing(const std::string &book_path, const int solver_count) {
+  using cl = std::chrono::high_resolution_clock;
+  SolverConfig config;
+  config.table_size = 1009;
+
+  std::cout << "Opening book: " << book_path << ", " << solver_count
+            << " solvers.\n\n"
+            << std::left << std::setw(20) << "book" << std::right
+            << std::setw(14) << "startup (ms)" << std::setw(14) << "heap (MB)"
+            << '\n';
+  for (const bool shared : {true, false}) {
+    const size_t heap_before = heapInUse();
+    const auto start = cl::now();
+    std::vector<std::unique_ptr<Solver>> solvers;
+    std::shared_ptr<const OpeningBook> book;
+    for (int i = 0; i < solver_count; i++) {
+      if (!shared || !book) {
+        book = OpeningBook::Load(book_path);
+      }
+      solvers.push_back(std::make_unique<Solver>(config));
+      solvers.back()->SetOpeningBook(book);
+    }
+    const auto end = cl::now();
+    const std::chrono::duration<double, std::milli> time_taken = end - start;
+    const double heap_mb =
+        static_cast<double>(heapInUse() - heap_before) / (1024 * 1024);
+
+    std::cout << std::left << std::setw(20) << (shared ? "shared" : "private")
+              << std::right << std::fixed << std::setprecision(1)
+              << std::setw(14) << time_taken.count() << std::setw(14)
+              << heap_mb << '\n';
+  }
+}
+}  // namespace
+
+int main(const int argc, const char **argv) {
+  const auto variants = makeVariants();
+
+  cxxopts::Options options("c4_bench", "Benchmark solver configurations");
+  options.add_options()(
+      "s,set", "Position set: endgame, midgame or opening",
+      cxxopts::value<std::string>()->default_value("endgame"))(
+      "n,count", "Number of positions",
+      cxxopts::value<int>()->default_value("200"))(
+      "p,positions", "Text or binary position file to use instead of a set",
+      cxxopts::value<std::string>()->default_value(""))(
+      "seed", "Seed of the position generator",
+      cxxopts::value<uint32_t>()->default_value("42"))(
+      "v,variants", "Comma separated solver configurations to compare",
+      cxxopts::value<std::vector<std::string>>()->default_value(
+          "generic,default"))(
+      "opening-book", "Opening book to load into every solver",
+      cxxopts::value<std::string>()->default_value(""))(
+      "book-solvers",
+      "Compare the startup of this many solvers sharing the opening book "
+      "against private copies, instead of solving",
+      cxxopts::value<int>())(
+      "table-stats", "Report the lookups of the memoization tables")(
+      "allocations",
+      "Also check that no solver query allocates on the heap once warmed up")(
+      "l,list", "List the available configurations")("h,help",
+                                                      "Print this help menu");
+
+  cxxopts::ParseResult result;
+  try {
+    result = options.parse(argc, argv);
+  } catch (cxxopts::exceptions::exception &e) {
+    std::cerr << e.what() << '\n' << options.help();
+    return 1;
+  }
+
+  if (result.contains("help")) {
+    std::cout << options.help();
+    return 0;
+  }
+
+  if (result.contains("list")) {
+    for (const auto &[name, variant] : variants) {
+      std::cout << std::left << std::setw(20) << name << variant.description
+                << '\n';
+    }
+    return 0;
+  }
+
+  if (result.contains("book-solvers")) {
+    compareBookSharing(result["opening-book"].as<std::string>(),
+                       std::max(1, result["book-solvers"].as<int>()));
+    return 0;
+  }
+
+  std::vector<Position> positions;
+  const auto positions_path = result["positions"].as<std::string>();
+  if (!positions_path.empty()) {
+    if (!LoadPositions(positions_path, positions)) {
+      std::cerr << "Cannot read " << positions_path << '\n';
+      return 1;
+    }
+    const auto count = static_cast<size_t>(result["count"].as<int>());
+    if (result.count("count") != 0 && positions.size() > count) {
+      positions.resize(count);
+    }
+    std::cout << "Position file: " << positions_path << ", "
+              << positions.size() << " positions.\n\n";
+  } else {
+    const auto set_name = result["set"].as<std::string>();
+    const auto set = POSITION_SETS.find(set_name);
+    if (set == POSITION_SETS.end()) {
+      std::cerr << "Unknown position set: " << set_name << '\n';
+      return 1;
+    }
+
+    positions =
+        generatePositions(result["count"].as<int>(), set->second.first,
+                          set->second.second, result["seed"].as<uint32_t>());
+    std::cout << "Position set: " << set_name << ", " << positions.size()
+              << " positions, " << set->second.first << " to "
+              << set->second.second << " moves played.\n\n";
+  }
+
+  std::cout << std::left << std::setw(20) << "config" << std::right
+            << std::setw(14) << "nodes" << std::setw(12) << "time (ms)"
+            << std::setw(14) << "nodes/s" << std::setw(12) << "us/pos"
+            << '\n';
+
+  const auto book =
+      OpeningBook::Load(result["opening-book"].as<std::string>());
+
+  std::vector<int> reference_scores;
+  std::string reference_name;
+  // variant name, heap allocations and queries of the allocation check
+  std::vector<std::tuple<std::string, uint64_t, uint64_t>> allocation_checks;
+  std::vector<std::pair<std::string, ForcingStats>> forcing_results;
+  std::vector<std::pair<std::string, EnhancedCutoffStats>> cutoff_results;
+  std::vector<std::pair<std::string, ZugzwangStats>> zugzwang_results;
+  std::vector<std::pair<std::string, ProofNumberStats>> proof_number_results;
+  std::vector<std::string> table_reports;
+  for (const auto &name : result["variants"].as<std::vector<std::string>>()) {
+    const auto variant = variants.find(name);
+    if (variant == variants.end()) {
+      std::cerr << "Unknown configuration: " << name << '\n';
+      return 1;
+    }
+
+    Solver solver(variant->second.config);
+    solver.SetOpeningBook(book);
+
+    const RunResult run_result = run(solver, positions);
+    const double nodes_per_sec =
+        static_cast<double>(run_result.nodes) / (run_result.time_ms / 1000);
+
+    std::cout << std::left << std::setw(20) << name << std::right
+              << std::setw(14) << run_result.nodes << std::setw(12)
+              << std::fixed << std::setprecision(1) << run_result.time_ms
+              << std::setw(14) << std::setprecision(0) << nodes_per_sec
+              << std::setw(12) << std::setprecision(1)
+              << run_result.time_ms * 1000 /
+                     static_cast<double>(positions.size())
+              << '\n';
+
+    if (result.contains("table-stats")) {
+      table_reports.push_back(
+          name + ": main table " +
+          tableReport(solver.GetTranspositionTable().GetStats()));
+      if (solver.GetNearLeafTable().IsEnabled()) {
+        table_reports.back() +=
+            ", near-leaf table " +
+            tableReport(solver.GetNearLeafTable().GetStats());
+      }
+      std::ostringstream reset_report;
+      reset_report << ", reset in " << std::fixed << std::setprecision(3)
+                   << run_result.reset_ms /
+                          static_cast<double>(positions.size())
+                   << " ms per position";
+      table_reports.back() += reset_report.str();
+    }
+
+    if (variant->second.config.forcing_search) {
+      forcing_results.emplace_back(name, solver.GetForcingStats());
+    }
+    if (variant->second.config.enhanced_cutoffs) {
+      cutoff_results.emplace_back(name, solver.GetEnhancedCutoffStats());
+    }
+    if (variant->second.config.zugzwang_rules) {
+      zugzwang_results.emplace_back(name, solver.GetZugzwangStats());
+    }
+    if (variant->second.config.backend == SearchBackend::kProofNumber) {
+      proof_number_results.emplace_back(name, solver.GetProofNumberStats());
+    }
+
+    if (reference_scores.empty()) {
+      reference_scores = run_result.scores;
+      reference_name = name;
+    } else if (run_result.scores != reference_scores) {
+      std::cerr << "Scores of " << name << " differ from " << reference_name
+                << "!\n";
+      return 1;
+    }
+
+    if (result.contains("allocations")) {
+      const auto [allocations, queries] =
+          countQueryAllocations(solver, positions);
+      allocation_checks.emplace_back(name, allocations, queries);
+    }
+  }
+
+  if (!table_reports.empty()) {
+    std::cout << '\n';
+  }
+  for (const auto &report : table_reports) {
+    std::cout << report << '\n';
+  }
+
+  if (!forcing_results.empty()) {
+    std::cout << '\n';
+  }
+  for (const auto &[name, stats] : forcing_results) {
+    std::cout << name << ": forced wins found in " << stats.wins << " of "
+              << stats.searches << " searches, " << stats.probe_cutoffs
+              << " cutoffs in " << stats.probes << " Negamax probes\n";
+  }
+
+  if (!cutoff_results.empty()) {
+    std::cout << '\n';
+  }
+  for (const auto &[name, stats] : cutoff_results) {
+    std::cout << name << ": " << stats.cutoffs << " cutoffs in "
+              << stats.searches << " positions looked ahead\n";
+  }
+
+  if (!zugzwang_results.empty()) {
+    int first_player_positions = 0;
+    int proved_positions = 0;
+    for (const auto &pos : positions) {
+      if (pos.NumMoves() % 2 == 0) {
+        first_player_positions++;
+        proved_positions += ProvesNoWin(pos) ? 1 : 0;
+      }
+    }
+    std::cout << "\nzugzwang rules prove " << proved_positions << " of the "
+              << first_player_positions
+              << " positions with the first player to move not won\n";
+  }
+  for (const auto &[name, stats] : zugzwang_results) {
+    std::cout << name << ": " << stats.proofs << " proofs in "
+              << stats.probes << " probes\n";
+  }
+
+  if (!proof_number_results.empty()) {
+    std::cout << '\n';
+  }
+  for (const auto &[name, stats] : proof_number_results) {
+    std::cout << name << ": " << stats.searches << " proof-number tests, "
+              << stats.proofs << " proved, " << stats.disproofs
+              << " disproved, " << stats.fallbacks
+              << " handed over to Negamax, " << stats.nodes << " nodes\n";
+  }
+
+  bool allocated = false;
+  if (!allocation_checks.empty()) {
+    std::cout << '\n';
+  }
+  for (const auto &[name, allocations, queries] : allocation_checks) {
+    std::cout << name << ": " << allocations << " heap allocations in " << queries
+              << " queries after warmup\n";
+    allocated = allocated || allocations != 0;
+  }
+  return allocated ? 1 : 0;
+}
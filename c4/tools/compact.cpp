@@ -0,0 +1,73 @@
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/book_compactor.hpp"
+#include "core/solved_log.hpp"
+#include "cxxopts/cxxopts.hpp"
+
+int main(const int argc, const char **argv) {
+  cxxopts::Options options(
+      "c4_compact", "Merge solved logs written with --solved-log into a book");
+  options.add_options()(
+      "logs",
+      "Solved logs, as passed to --solved-log, or log segment files. Only "
+      "the segments no process writes any more are merged.",
+      cxxopts::value<std::vector<std::string>>())(
+      "book", "Book to merge the logs into, created if missing",
+      cxxopts::value<std::string>()->default_value("data/solved.book"))(
+      "min-nodes",
+      "Only keep the positions which took at least this many nodes to solve",
+      cxxopts::value<uint64_t>()->default_value("0"))(
+      "remove", "Remove the log segments once they are merged")(
+      "h,help", "Print this help menu");
+  options.parse_positional({"logs"});
+  options.positional_help("LOG...");
+
+  cxxopts::ParseResult result;
+  try {
+    result = options.parse(argc, argv);
+  } catch (cxxopts::exceptions::exception &e) {
+    std::cerr << e.what() << '\n' << options.help();
+    return 1;
+  }
+
+  if (result.contains("help") || !result.contains("logs")) {
+    std::cout << options.help();
+    return 0;
+  }
+
+  const auto logs = result["logs"].as<std::vector<std::string>>();
+  const auto book = result["book"].as<std::string>();
+  // locked until the end, so that a concurrent compaction takes none of them
+  std::vector<std::unique_ptr<SealedSegments>> segments;
+  std::vector<std::string> segment_paths;
+  for (const std::string &log : logs) {
+    segments.push_back(std::make_unique<SealedSegments>(log));
+    const auto &paths = segments.back()->GetPaths();
+    if (paths.empty()) {
+      std::cerr << "No sealed segment of " << log << '\n';
+    }
+    segment_paths.insert(segment_paths.end(), paths.begin(), paths.end());
+  }
+  const CompactionReport report =
+      CompactLogs(segment_paths, book, result["min-nodes"].as<uint64_t>());
+  if (!report.ok) {
+    std::cerr << report.error << '\n';
+    return 1;
+  }
+  std::cout << "Merged " << report.log_records << " records into " << book
+            << " in " << report.seconds << " seconds: " << report.added
+            << " added, " << report.duplicates << " duplicates, "
+            << report.conflicts << " conflicts, " << report.skipped
+            << " below --min-nodes, " << report.book_size << " positions.\n";
+
+  if (result.contains("remove")) {
+    for (const auto &log_segments : segments) {
+      log_segments->Remove();
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,218 @@
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/position.hpp"
+#include "cxxopts/cxxopts.hpp"
+#include "robin/robin_hood.h"
+
+namespace {
+constexpr int MAX_PLY = Position::WIDTH * Position::HEIGHT;
+
+using PlyCounts = std::array<uint64_t, MAX_PLY + 1>;
+
+/**
+ * Set of Key3 keys shared by all the threads. Keys are spread over shards by
+ * their hash, each shard with its own lock, so that threads rarely wait on
+ * each other.
+ */
+class ConcurrentKeySet {
+ public:
+  // return true if the key was not in the set yet
+  bool Insert(const uint64_t key) {
+    Shard &shard = shards.at(robin_hood::hash_int(key) % SHARD_COUNT);
+    const std::lock_guard<std::mutex> lock(shard.mutex);
+    return shard.keys.insert(key).second;
+  }
+
+ private:
+  static constexpr size_t SHARD_COUNT = 256;
+
+  struct Shard {
+    std::mutex mutex;
+    robin_hood::unordered_flat_set<uint64_t> keys;
+  };
+
+  std::array<Shard, SHARD_COUNT> shards;
+};
+
+struct Perft {
+  int max_ply = 0;
+  ConcurrentKeySet *seen = nullptr;  // null when not deduplicating
+
+  // Count pos and every position reachable from it up to max_ply. A winning
+  // move ends the game, so the position it leads to is counted but not
+  // expanded. Returns the number of nodes generated.
+  uint64_t Count(const Position &pos, PlyCounts &counts) const {
+    if (seen != nullptr && !seen->Insert(pos.Key3())) {
+      return 1;
+    }
+    counts.at(pos.NumMoves())++;
+    if (pos.NumMoves() >= max_ply) {
+      return 1;
+    }
+
+    uint64_t nodes = 1;
+    for (int col = 0; col < Position::WIDTH; col++) {
+      if (!pos.CanPlay(col)) {
+        continue;
+      }
+      Position next(pos);
+      next.PlayCol(col);
+      if (pos.IsWinningMove(col)) {
+        nodes++;
+        if (seen == nullptr || seen->Insert(next.Key3())) {
+          counts.at(next.NumMoves())++;
+        }
+        continue;
+      }
+      nodes += Count(next, counts);
+    }
+    return nodes;
+  }
+
+  // Same walk as Count, but stops at split_ply and hands the positions found
+  // there over as work items for the threads
+  uint64_t Split(const Position &pos, const int split_ply, PlyCounts &counts,
+                 std::vector<Position> &work) const {
+    if (pos.NumMoves() == split_ply && split_ply < max_ply) {
+      work.push_back(pos);
+      return 0;
+    }
+    if (seen != nullptr && !seen->Insert(pos.Key3())) {
+      return 1;
+    }
+    counts.at(pos.NumMoves())++;
+    if (pos.NumMoves() >= max_ply) {
+      return 1;
+    }
+
+    uint64_t nodes = 1;
+    for (int col = 0; col < Position::WIDTH; col++) {
+      if (!pos.CanPlay(col)) {
+        continue;
+      }
+      Position next(pos);
+      next.PlayCol(col);
+      if (pos.IsWinningMove(col)) {
+        nodes++;
+        if (seen == nullptr || seen->Insert(next.Key3())) {
+          counts.at(next.NumMoves())++;
+        }
+        continue;
+      }
+      nodes += Split(next, split_ply, counts, work);
+    }
+    return nodes;
+  }
+};
+}  // namespace
+
+int main(const int argc, const char **argv) {
+  cxxopts::Options options(
+      "c4_perft", "Count the positions reachable at every ply of the game");
+  options.add_options()("d,depth", "Number of plies to explore",
+                        cxxopts::value<int>()->default_value("8"))(
+      "j,threads", "Number of threads",
+      cxxopts::value<unsigned int>()->default_value(
+          std::to_string(std::max(1U, std::thread::hardware_concurrency()))))(
+      "split-depth", "Ply at which the tree is split into work items",
+      cxxopts::value<int>()->default_value("4"))(
+      "u,unique",
+      "Count distinct positions only, mirrored positions being the same")(
+      "s,sequence", "Start from the position reached by this sequence",
+      cxxopts::value<std::string>()->default_value(""))(
+      "h,help", "Print this help menu");
+
+  cxxopts::ParseResult result;
+  try {
+    result = options.parse(argc, argv);
+  } catch (cxxopts::exceptions::exception &e) {
+    std::cerr << e.what() << '\n' << options.help();
+    return 1;
+  }
+
+  if (result.contains("help")) {
+    std::cout << options.help();
+    return 0;
+  }
+
+  Position start;
+  const auto sequence = result["sequence"].as<std::string>();
+  if (start.Play(sequence) != sequence.size()) {
+    std::cerr << "Invalid sequence: " << sequence << '\n';
+    return 1;
+  }
+
+  Perft perft;
+  perft.max_ply = std::min(MAX_PLY, start.NumMoves() +
+                                        std::max(0, result["depth"].as<int>()));
+  auto seen = std::make_unique<ConcurrentKeySet>();
+  if (result.contains("unique")) {
+    perft.seen = seen.get();
+  }
+  const int split_ply = std::min(
+      perft.max_ply,
+      start.NumMoves() + std::max(0, result["split-depth"].as<int>()));
+  const unsigned int thread_count =
+      std::max(1U, result["threads"].as<unsigned int>());
+
+  using cl = std::chrono::high_resolution_clock;
+  const auto time_start = cl::now();
+
+  PlyCounts counts{};
+  std::vector<Position> work;
+  std::atomic<uint64_t> nodes{perft.Split(start, split_ply, counts, work)};
+
+  std::atomic<size_t> next_item{0};
+  std::mutex counts_mutex;
+  std::vector<std::thread> threads;
+  for (unsigned int t = 0; t < thread_count; t++) {
+    threads.emplace_back([&]() {
+      PlyCounts local_counts{};
+      uint64_t local_nodes = 0;
+      for (size_t i = next_item++; i < work.size(); i = next_item++) {
+        local_nodes += perft.Count(work[i], local_counts);
+      }
+      nodes += local_nodes;
+      const std::lock_guard<std::mutex> lock(counts_mutex);
+      for (size_t ply = 0; ply < counts.size(); ply++) {
+        counts.at(ply) += local_counts.at(ply);
+      }
+    });
+  }
+  for (auto &thread : threads) {
+    thread.join();
+  }
+
+  const auto time_end = cl::now();
+  const std::chrono::duration<double> time_taken = time_end - time_start;
+
+  std::cout << std::setw(6) << "ply" << std::setw(18)
+            << (perft.seen != nullptr ? "distinct" : "positions") << '\n';
+  uint64_t total = 0;
+  for (int ply = start.NumMoves(); ply <= perft.max_ply; ply++) {
+    std::cout << std::setw(6) << ply << std::setw(18) << counts.at(ply)
+              << '\n';
+    total += counts.at(ply);
+  }
+
+  std::cout << "\nTotal: " << total << " positions, " << nodes
+            << " nodes generated, " << work.size() << " work items on "
+            << thread_count << " threads.\n"
+            << "Time taken: " << time_taken.count() << " seconds, "
+            << std::fixed << std::setprecision(0)
+            << static_cast<double>(nodes) / time_taken.count()
+            << " nodes/s.\n";
+
+  return 0;
+}
@@ -0,0 +1,107 @@
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include "core/position.hpp"
+#include "core/position_io.hpp"
+#include "cxxopts/cxxopts.hpp"
+
+namespace {
+int textToBinary(const std::string &input, const std::string &output) {
+  TextPositionReader reader(input);
+  BinaryPositionWriter writer(output);
+  if (!reader.IsOpen() || !writer.IsOpen()) {
+    std::cerr << "Cannot open " << (reader.IsOpen() ? output : input) << '\n';
+    return 1;
+  }
+
+  uint64_t count = 0;
+  Position pos;
+  while (reader.Next(pos)) {
+    writer.Write(pos);
+    count++;
+  }
+  writer.Close();
+
+  std::cout << "Converted " << count << " positions, skipped "
+            << reader.GetInvalidCount() << " invalid sequences.\n";
+  return 0;
+}
+
+int binaryToText(const std::string &input, const std::string &output) {
+  BinaryPositionReader reader(input);
+  TextPositionWriter writer(output);
+  if (!reader.IsOpen()) {
+    std::cerr << "Invalid binary position file: " << input << '\n';
+    return 1;
+  }
+  if (!writer.IsOpen()) {
+    std::cerr << "Cannot open " << output << '\n';
+    return 1;
+  }
+
+  uint64_t count = 0;
+  uint64_t unreachable = 0;
+  Position pos;
+  while (reader.Next(pos)) {
+    if (writer.Write(pos)) {
+      count++;
+    } else {
+      unreachable++;
+    }
+  }
+
+  std::cout << "Converted " << count << " positions, skipped "
+            << reader.GetInvalidCount() << " invalid records and "
+            << unreachable << " unreachable positions.\n";
+  return 0;
+}
+}  // namespace
+
+int main(const int argc, const char **argv) {
+  cxxopts::Options options(
+      "c4_posconv",
+      "Convert position files between move sequences and binary records");
+  options.add_options()("input", "Input file", cxxopts::value<std::string>())(
+      "output", "Output file", cxxopts::value<std::string>())(
+      "h,help", "Print this help menu");
+  options.parse_positional({"input", "output"});
+  options.positional_help("INPUT OUTPUT");
+
+  cxxopts::ParseResult result;
+  try {
+    result = options.parse(argc, argv);
+  } catch (cxxopts::exceptions::exception &e) {
+    std::cerr << e.what() << '\n' << options.help();
+    return 1;
+  }
+
+  if (result.contains("help") || !result.contains("input") ||
+      !result.contains("output")) {
+    std::cout << options.help();
+    return 0;
+  }
+
+  const auto input = result["input"].as<std::string>();
+  const auto output = result["output"].as<std::string>();
+
+  const auto start = std::chrono::high_resolution_clock::now();
+  int status = 1;
+  switch (DetectPositionFormat(input)) {
+    case PositionFormat::kText:
+      status = textToBinary(input, output);
+      break;
+    case PositionFormat::kBinary:
+      status = binaryToText(input, output);
+      break;
+    case PositionFormat::kUnknown:
+      std::cerr << "Cannot open " << input << '\n';
+      break;
+  }
+  const auto end = std::chrono::high_resolution_clock::now();
+  const std::chrono::duration<double, std::milli> time_taken = end - start;
+  std::cout << "Time taken: " << time_taken.count() << " ms.\n";
+
+  return status;
+}
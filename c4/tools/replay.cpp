@@ -0,0 +1,174 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "core/opening_book.hpp"
+#include "core/solver.hpp"
+#include "core/trace.hpp"
+#include "cxxopts/cxxopts.hpp"
+
+namespace {
+double percentile(std::vector<double> values, const double fraction) {
+  if (values.empty()) {
+    return 0;
+  }
+  std::sort(values.begin(), values.end());
+  const auto index = static_cast<size_t>(fraction *
+                                         static_cast<double>(values.size() - 1));
+  return values.at(index);
+}
+}  // namespace
+
+int main(const int argc, const char **argv) {
+  cxxopts::Options options(
+      "c4_replay",
+      "Run the queries of a solver trace again and compare their latency");
+  options.add_options()("trace", "Trace recorded with c4 --trace",
+                        cxxopts::value<std::string>())(
+      "opening-book", "Specify an opening book.",
+      cxxopts::value<std::string>()->default_value("data/opening.book"))(
+      "warmup-book", "Specify a warmup book.",
+      cxxopts::value<std::string>()->default_value("data/warmup.book"))(
+      "seed", "Seed of every solver, 0 to use the recorded seeds",
+      cxxopts::value<uint32_t>()->default_value("0"))(
+      "record", "Record the replayed queries into this trace",
+      cxxopts::value<std::string>()->default_value(""))(
+      "q,quiet", "Only print the summary")("h,help", "Print this help menu");
+  options.parse_positional({"trace"});
+  options.positional_help("TRACE");
+
+  cxxopts::ParseResult result;
+  try {
+    result = options.parse(argc, argv);
+  } catch (cxxopts::exceptions::exception &e) {
+    std::cerr << e.what() << '\n' << options.help();
+    return 1;
+  }
+
+  if (result.contains("help") || !result.contains("trace")) {
+    std::cout << options.help();
+    return 0;
+  }
+
+  const auto trace_path = result["trace"].as<std::string>();
+  std::vector<TraceSolver> trace_solvers;
+  std::vector<TraceQuery> queries;
+  if (!ReadTrace(trace_path, trace_solvers, queries)) {
+    std::cerr << "Cannot read the trace " << trace_path << '\n';
+    return 1;
+  }
+
+  std::shared_ptr<TraceRecorder> recorder;
+  const auto record_path = result["record"].as<std::string>();
+  if (!record_path.empty()) {
+    recorder = std::make_shared<TraceRecorder>(record_path);
+    if (!recorder->IsOpen()) {
+      std::cerr << "Cannot write the trace " << record_path << '\n';
+      return 1;
+    }
+  }
+
+  const auto book = OpeningBook::Load(result["opening-book"].as<std::string>(),
+                                      result["warmup-book"].as<std::string>());
+  const auto seed = result["seed"].as<uint32_t>();
+  std::map<int, std::unique_ptr<Solver>> solvers;
+  for (const TraceSolver &trace_solver : trace_solvers) {
+    SolverConfig config = trace_solver.config;
+    config.seed = seed != 0 ? seed : trace_solver.seed;
+    config.trace = recorder;
+    auto solver = std::make_unique<Solver>(config);
+    solver->SetOpeningBook(book);
+    solvers[trace_solver.id] = std::move(solver);
+  }
+
+  const bool quiet = result.contains("quiet");
+  if (!quiet) {
+    std::cout << std::left << std::setw(8) << "query" << std::setw(8)
+              << "solver" << std::setw(24) << "name" << std::right
+              << std::setw(14) << "recorded us" << std::setw(14)
+              << "replay us" << std::setw(10) << "delta %" << std::setw(14)
+              << "nodes" << std::setw(8) << "result" << '\n';
+  }
+
+  using cl = std::chrono::high_resolution_clock;
+  std::vector<double> recorded_us;
+  std::vector<double> replay_us;
+  std::vector<double> ratios;
+  size_t mismatches = 0;
+  std::vector<int> query_result;
+  for (size_t i = 0; i < queries.size(); i++) {
+    const TraceQuery &query = queries[i];
+    const auto solver = solvers.find(query.solver);
+    if (solver == solvers.end()) {
+      std::cerr << "Query " << i << " uses the unknown solver " << query.solver
+                << '\n';
+      return 1;
+    }
+
+    const auto start = cl::now();
+    if (!ReplayQuery(*solver->second, query, query_result)) {
+      std::cerr << "Query " << i << " is unknown: " << query.query << '\n';
+      return 1;
+    }
+    const auto end = cl::now();
+    if (query.query == "reset") {
+      continue;
+    }
+
+    const std::chrono::duration<double, std::micro> time_taken = end - start;
+    const bool same = query_result == query.result;
+    mismatches += same ? 0 : 1;
+    recorded_us.push_back(query.time_us);
+    replay_us.push_back(time_taken.count());
+    const double delta =
+        query.time_us > 0 ? 100 * (time_taken.count() / query.time_us - 1) : 0;
+    ratios.push_back(delta);
+
+    if (!quiet) {
+      std::cout << std::left << std::setw(8) << i << std::setw(8)
+                << query.solver << std::setw(24) << query.query << std::right
+                << std::fixed << std::setprecision(1) << std::setw(14)
+                << query.time_us << std::setw(14) << time_taken.count()
+                << std::setw(10) << delta << std::setw(14) << query.nodes
+                << std::setw(8) << (same ? "same" : "DIFF") << '\n';
+    }
+  }
+
+  double recorded_total = 0;
+  double replay_total = 0;
+  for (size_t i = 0; i < replay_us.size(); i++) {
+    recorded_total += recorded_us[i];
+    replay_total += replay_us[i];
+  }
+  std::cout << std::fixed << std::setprecision(1) << "\nReplayed "
+            << replay_us.size() << " queries of " << solvers.size()
+            << " solvers, " << mismatches << " with a different result.\n"
+            << "Total: recorded " << recorded_total / 1000 << " ms, replay "
+            << replay_total / 1000 << " ms ("
+            << (recorded_total > 0
+                    ? 100 * (replay_total / recorded_total - 1)
+                    : 0)
+            << "%).\n";
+  std::cout << std::setw(12) << "latency us" << std::setw(12) << "recorded"
+            << std::setw(12) << "replay" << std::setw(12) << "delta %"
+            << '\n';
+  for (const double fraction : {0.5, 0.9, 0.99, 1.0}) {
+    const std::string name =
+        fraction == 1.0 ? "max" : "p" + std::to_string(static_cast<int>(
+                                             fraction * 100));
+    std::cout << std::setw(12) << name << std::setw(12)
+              << percentile(recorded_us, fraction) << std::setw(12)
+              << percentile(replay_us, fraction) << std::setw(12)
+              << percentile(ratios, fraction) << '\n';
+  }
+
+  // results only differ when the engine changed, or for queries stopped by
+  // a time budget
+  return mismatches == 0 ? 0 : 2;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "core/position.hpp"
+
+// Assertions of the test executables: a failed CHECK reports the condition
+// and the test keeps going, main then returns Failures() != 0
+inline int &Failures() {
+  static int failures = 0;
+  return failures;
+}
+
+#define CHECK(condition)                                              \
+  do {                                                                \
+    if (!(condition)) {                                               \
+      std::cerr << __FILE__ << ':' << __LINE__ << ": CHECK failed: " \
+                << #condition << '\n';                                \
+      Failures()++;                                                   \
+    }                                                                 \
+  } while (false)
+
+// Undecided positions reached by random non-losing moves, with a number of
+// moves played drawn from [min_ply, max_ply]
+inline std::vector<Position> RandomPositions(const int count,
+                                             const int min_ply,
+                                             const int max_ply,
+                                             const uint32_t seed) {
+  std::mt19937 gen(seed);
+  std::uniform_int_distribution<> ply_dist(min_ply, max_ply);
+  std::uniform_int_distribution<> col_dist(0, Position::WIDTH - 1);
+
+  std::vector<Position> positions;
+  while (static_cast<int>(positions.size()) < count) {
+    const int ply = ply_dist(gen);
+    Position pos;
+    while (pos.NumMoves() < ply && !pos.CanWinNext()) {
+      const uint64_t moves = pos.PossibleNonLosingMoves();
+      if (moves == 0) {
+        break;
+      }
+      int col = col_dist(gen);
+      while ((moves & Position::ColumnMask(col)) == 0) {
+        col = col_dist(gen);
+      }
+      pos.PlayCol(col);
+    }
+    if (pos.NumMoves() == ply && !pos.CanWinNext() &&
+        pos.PossibleNonLosingMoves() != 0) {
+      positions.push_back(pos);
+    }
+  }
+  return positions;
+}
@@ -0,0 +1,116 @@
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "core/position.hpp"
+#include "core/position_io.hpp"
+
+namespace {
+bool samePosition(const Position &a, const Position &b) {
+  return a.GetMask() == b.GetMask() &&
+         a.GetCurrentPosition() == b.GetCurrentPosition() &&
+         a.NumMoves() == b.NumMoves();
+}
+
+void binaryRoundTrip(const std::vector<Position> &positions) {
+  const std::string path = "position_io_test.bin";
+  {
+    BinaryPositionWriter writer(path);
+    CHECK(writer.IsOpen());
+    for (const Position &pos : positions) {
+      writer.Write(pos);
+    }
+    // a stone above an empty cell, and four in a row on the bottom row
+    writer.Write(Position(0, UINT64_C(0x2)));
+    writer.Write(
+        Position(UINT64_C(0x40000008102), UINT64_C(0x4000020c183)));
+  }
+
+  CHECK(DetectPositionFormat(path) == PositionFormat::kBinary);
+  BinaryPositionReader reader(path);
+  CHECK(reader.IsOpen());
+  CHECK(reader.GetRecordCount() == positions.size() + 2);
+  Position pos;
+  size_t read = 0;
+  while (reader.Next(pos)) {
+    CHECK(read < positions.size() && samePosition(pos, positions[read]));
+    read++;
+  }
+  CHECK(read == positions.size());
+  CHECK(reader.GetInvalidCount() == 2);
+
+  // a header announcing more records than the file holds
+  {
+    std::fstream file(path, std::ios::binary | std::ios::in | std::ios::out);
+    const uint64_t record_count = positions.size() + 3;
+    file.seekp(offsetof(PositionFileHeader, record_count));
+    file.write(reinterpret_cast<const char *>(&record_count),
+               sizeof(record_count));
+  }
+  CHECK(!BinaryPositionReader(path).IsOpen());
+  std::remove(path.c_str());
+}
+
+void textRoundTrip(const std::vector<Position> &positions) {
+  const std::string path = "position_io_test.txt";
+  {
+    TextPositionWriter writer(path);
+    CHECK(writer.IsOpen());
+    for (const Position &pos : positions) {
+      CHECK(writer.Write(pos));
+    }
+    writer.Write(std::string_view("8"));
+    writer.Write(std::string_view(""));
+    writer.Write(std::string_view("1111111"));
+  }
+
+  CHECK(DetectPositionFormat(path) == PositionFormat::kText);
+  TextPositionReader reader(path);
+  CHECK(reader.IsOpen());
+  Position pos;
+  size_t read = 0;
+  while (reader.Next(pos)) {
+    CHECK(read < positions.size() && samePosition(pos, positions[read]));
+    Position replayed;
+    CHECK(replayed.Play(reader.GetSequence()) == reader.GetSequence().size());
+    CHECK(samePosition(replayed, pos));
+    read++;
+  }
+  CHECK(read == positions.size());
+  CHECK(reader.GetInvalidCount() == 2);  // the empty line is skipped
+
+  std::vector<Position> loaded;
+  CHECK(LoadPositions(path, loaded));
+  CHECK(loaded.size() == positions.size());
+  std::remove(path.c_str());
+}
+
+void findSequence() {
+  std::string sequence;
+  CHECK(FindSequence(Position(), sequence) && sequence.empty());
+
+  Position pos;
+  pos.Play("4453");
+  CHECK(FindSequence(Position(pos.GetCurrentPosition(), pos.GetMask()),
+                     sequence));
+  Position replayed;
+  CHECK(replayed.Play(sequence) == sequence.size());
+  CHECK(samePosition(replayed, pos));
+
+  // four in a row on the bottom row: the game would have ended
+  CHECK(!FindSequence(
+      Position(UINT64_C(0x40000008102), UINT64_C(0x4000020c183)), sequence));
+}
+}  // namespace
+
+int main() {
+  const std::vector<Position> positions = RandomPositions(300, 1, 40, 7);
+  binaryRoundTrip(positions);
+  textRoundTrip(positions);
+  findSequence();
+  return Failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,63 @@
+#include <cstdint>
+#include <random>
+
+#include "check.hpp"
+#include "core/position.hpp"
+
+namespace {
+// Compare what the threats kept up to date by Play tell about pos with the
+// threats the bitboard constructor computes from scratch
+void checkThreats(const Position &pos) {
+  const Position rebuilt(pos.GetCurrentPosition(), pos.GetMask());
+  CHECK(pos.ThreatCount() == rebuilt.ThreatCount());
+  CHECK(pos.OpponentThreatCount() == rebuilt.OpponentThreatCount());
+  CHECK(pos.ForcedMoves() == rebuilt.ForcedMoves());
+  CHECK(pos.CanWinNext() == rebuilt.CanWinNext());
+  for (int col = 0; col < Position::WIDTH; col++) {
+    if (!pos.CanPlay(col)) {
+      continue;
+    }
+    CHECK(pos.IsWinningMove(col) == rebuilt.IsWinningMove(col));
+    const uint64_t move =
+        (pos.GetMask() + (UINT64_C(1) << col * (Position::HEIGHT + 1))) &
+        Position::ColumnMask(col);
+    CHECK(pos.MoveScoreParity(move) == rebuilt.MoveScoreParity(move));
+  }
+  if (!pos.CanWinNext()) {
+    CHECK(pos.PossibleNonLosingMoves() == rebuilt.PossibleNonLosingMoves());
+  }
+}
+}  // namespace
+
+int main() {
+  std::mt19937 gen(5);
+  std::uniform_int_distribution<> col_dist(0, Position::WIDTH - 1);
+  for (int game = 0; game < 2000; game++) {
+    Position pos;
+    checkThreats(pos);
+    // random moves, losing ones too, until the player to move can win
+    while (pos.NumMoves() < Position::WIDTH * Position::HEIGHT &&
+           !pos.CanWinNext()) {
+      int col = col_dist(gen);
+      while (!pos.CanPlay(col)) {
+        col = col_dist(gen);
+      }
+      pos.PlayCol(col);
+      checkThreats(pos);
+    }
+  }
+
+  // the threats of a position built from a board match the bitboard ones
+  Position pos;
+  pos.Play("4453366");
+  const Position from_board({{0, 0, 0, 0, 0, 0, 0},
+                             {0, 0, 0, 0, 0, 0, 0},
+                             {0, 0, 0, 0, 0, 0, 0},
+                             {0, 0, 0, 0, 0, 0, 0},
+                             {0, 0, 1, 2, 0, 1, 0},
+                             {0, 0, 2, 1, 1, 2, 0}});
+  CHECK(from_board.GetMask() == pos.GetMask());
+  CHECK(from_board.GetCurrentPosition() == pos.GetCurrentPosition());
+  checkThreats(from_board);
+  return Failures() == 0 ? 0 : 1;
+}
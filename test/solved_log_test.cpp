@@ -0,0 +1,130 @@
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "check.hpp"
+#include "core/book_compactor.hpp"
+#include "core/opening_book.hpp"
+#include "core/solved_log.hpp"
+
+namespace {
+namespace fs = std::filesystem;
+
+const fs::path DIRECTORY = "solved_log_test";
+const std::string LOG_PATH = (DIRECTORY / "solved.log").string();
+const std::string BOOK_PATH = (DIRECTORY / "solved.book").string();
+
+std::vector<SolvedRecord> readSegments(const SealedSegments &segments) {
+  std::vector<SolvedRecord> records;
+  for (const std::string &path : segments.GetPaths()) {
+    CHECK(SolvedLog::Read(path, records));
+  }
+  return records;
+}
+
+void appendAndRead() {
+  SolvedLog log(LOG_PATH);
+  CHECK(log.IsOpen());
+  log.Append({1, 10, 100});
+  log.Append({UINT64_C(0xFFFFFFFFFFFF), 37, UINT64_C(1) << 40});
+  CHECK(log.Seal());
+  log.Append({3, 12, 300});
+
+  {
+    // the segment still being written is left out
+    const SealedSegments segments(LOG_PATH);
+    CHECK(segments.GetPaths().size() == 1);
+    const std::vector<SolvedRecord> records = readSegments(segments);
+    CHECK(records.size() == 2);
+    if (records.size() == 2) {
+      CHECK(records[0].key == 1 && records[0].score == 10 &&
+            records[0].nodes == 100);
+      CHECK(records[1].key == UINT64_C(0xFFFFFFFFFFFF) &&
+            records[1].score == 37 && records[1].nodes == UINT64_C(1) << 40);
+    }
+    // another compactor cannot take the segments this one holds
+    CHECK(SealedSegments(LOG_PATH).GetPaths().empty());
+  }
+
+  CHECK(log.Seal());
+  CHECK(log.Seal());  // an empty segment is not sealed
+  SealedSegments segments(LOG_PATH);
+  CHECK(segments.GetPaths().size() == 2);
+  CHECK(readSegments(segments).size() == 3);
+  segments.Remove();
+}
+
+void tornRecord() {
+  {
+    SolvedLog log(LOG_PATH);
+    log.Append({7, 20, 700});
+  }
+  SealedSegments segments(LOG_PATH);
+  CHECK(segments.GetPaths().size() == 1);
+  if (segments.GetPaths().size() == 1) {
+    // a crash in the middle of a record
+    std::ofstream(segments.GetPaths()[0], std::ios::binary | std::ios::app)
+        .write("\x08\x00\x00", 3);
+    const std::vector<SolvedRecord> records = readSegments(segments);
+    CHECK(records.size() == 1 && records[0].key == 7);
+  }
+  segments.Remove();
+
+  {
+    const SolvedLog unused(LOG_PATH);
+  }
+  CHECK(SealedSegments(LOG_PATH).GetPaths().empty());  // nothing left behind
+}
+
+void mergePrecedence() {
+  CHECK(OpeningBook::WriteFile(BOOK_PATH, {{5, 30}, {1, 10}, {2, 20}}));
+  {
+    SolvedLog log(LOG_PATH);
+    log.Append({1, 11, 100});  // conflicts with the book, which wins
+    log.Append({2, 20, 100});  // already in the book
+    log.Append({4, 40, 100});  // new
+    log.Append({4, 41, 100});  // conflicts with the first record of the log
+    log.Append({3, 33, 5});    // too cheap
+    log.Append({6, 60, 100});  // new, after the last book key
+  }
+  SealedSegments segments(LOG_PATH);
+  const CompactionReport report =
+      CompactLogs(segments.GetPaths(), BOOK_PATH, 10);
+  CHECK(report.ok);
+  CHECK(report.log_records == 6);
+  CHECK(report.added == 2);
+  CHECK(report.duplicates == 1);
+  CHECK(report.conflicts == 2);
+  CHECK(report.skipped == 1);
+  CHECK(report.book_size == 5);
+
+  std::vector<OpeningBook::Record> book;
+  CHECK(OpeningBook::ReadFile(BOOK_PATH, book));
+  const std::vector<std::pair<uint64_t, uint8_t>> expected = {
+      {1, 10}, {2, 20}, {4, 40}, {5, 30}, {6, 60}};
+  CHECK(book.size() == expected.size());
+  for (size_t i = 0; i < book.size() && i < expected.size(); i++) {
+    CHECK(book[i].key == expected[i].first &&
+          book[i].score == expected[i].second);
+  }
+  segments.Remove();
+
+  // a missing log fails without touching the book
+  CHECK(!CompactLogs({LOG_PATH + ".missing"}, BOOK_PATH).ok);
+  book.clear();
+  CHECK(OpeningBook::ReadFile(BOOK_PATH, book) && book.size() == 5);
+}
+}  // namespace
+
+int main() {
+  fs::remove_all(DIRECTORY);
+  fs::create_directories(DIRECTORY);
+  appendAndRead();
+  tornRecord();
+  mergePrecedence();
+  fs::remove_all(DIRECTORY);
+  return Failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include <cstdint>
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "check.hpp"
+#include "core/position.hpp"
+#include "core/solver.hpp"
+#include "core/trace.hpp"
+
+namespace {
+const std::string TRACE_PATH = "trace_test.jsonl";
+
+SolverConfig plainConfig() {
+  SolverConfig config;
+  config.table_size = 65537;
+  return config;
+}
+
+// every setting away from its default, to check they are all recorded
+SolverConfig tunedConfig() {
+  SolverConfig config;
+  config.table_size = 32771;
+  config.endgame_threshold = 10;
+  config.weak = true;
+  config.hash_move = false;
+  config.move_ordering = MoveOrdering::kThreatParity;
+  config.forcing_search = true;
+  config.enhanced_cutoffs = true;
+  config.zugzwang_rules = true;
+  config.backend = SearchBackend::kProofNumber;
+  config.proof_nodes = 4096;
+  config.near_leaf_table_size = 4099;
+  config.near_leaf_ply = 20;
+  return config;
+}
+
+bool sameConfig(const SolverConfig &a, const SolverConfig &b) {
+  return a.table_size == b.table_size &&
+         a.endgame_threshold == b.endgame_threshold && a.weak == b.weak &&
+         a.hash_move == b.hash_move && a.move_ordering == b.move_ordering &&
+         a.forcing_search == b.forcing_search &&
+         a.enhanced_cutoffs == b.enhanced_cutoffs &&
+         a.zugzwang_rules == b.zugzwang_rules && a.backend == b.backend &&
+         a.proof_nodes == b.proof_nodes &&
+         a.near_leaf_table_size == b.near_leaf_table_size &&
+         a.near_leaf_ply == b.near_leaf_ply;
+}
+
+SearchLimits nodeLimits() {
+  SearchLimits limits;
+  limits.max_nodes = 5000;
+  limits.backend = SearchBackend::kNegamax;
+  return limits;
+}
+
+// Record the queries of two solvers, returns the results they gave
+std::vector<std::vector<int>> record(const std::vector<Position> &positions) {
+  auto recorder = std::make_shared<TraceRecorder>(TRACE_PATH);
+  CHECK(recorder->IsOpen());
+  SolverConfig plain = plainConfig();
+  plain.trace = recorder;
+  SolverConfig tuned = tunedConfig();
+  tuned.trace = recorder;
+  Solver plain_solver(plain);
+  Solver tuned_solver(tuned);
+
+  std::vector<std::vector<int>> results;
+  for (const Position &pos : positions) {
+    results.push_back({plain_solver.Solve(pos)});
+    results.push_back({plain_solver.FindBestMove(pos)});
+    const auto scores = plain_solver.ScoreColumns(pos);
+    results.emplace_back(scores.begin(), scores.end());
+    const SolveResult limited = tuned_solver.Solve(pos, nodeLimits());
+    results.push_back({limited.min, limited.max});
+    const RankedMoves ranked_moves = tuned_solver.Analyze(pos);
+    results.emplace_back(
+        ranked_moves.columns.begin(),
+        ranked_moves.columns.begin() + ranked_moves.BestCount());
+    results.push_back({tuned_solver.FindBestMove(pos, nodeLimits())});
+    results.push_back(plain_solver.PrincipalVariation(pos));
+  }
+  plain_solver.Reset();
+  results.emplace_back();
+  results.push_back({plain_solver.Solve(positions.front())});
+  return results;
+}
+}  // namespace
+
+int main() {
+  const std::vector<Position> positions = RandomPositions(20, 18, 26, 11);
+  const std::vector<std::vector<int>> results = record(positions);
+
+  std::vector<TraceSolver> solvers;
+  std::vector<TraceQuery> queries;
+  CHECK(ReadTrace(TRACE_PATH, solvers, queries));
+  CHECK(solvers.size() == 2);
+  CHECK(queries.size() == results.size());
+  if (solvers.size() != 2 || queries.size() != results.size()) {
+    return 1;
+  }
+  CHECK(sameConfig(solvers[0].config, plainConfig()));
+  CHECK(sameConfig(solvers[1].config, tunedConfig()));
+  CHECK(queries[0].mask == positions[0].GetMask());
+  CHECK(queries[0].current_position == positions[0].GetCurrentPosition());
+  CHECK(queries[3].query == "solve_limited" && queries[3].max_nodes == 5000 &&
+        queries[3].backend == SearchBackend::kNegamax);
+  CHECK(queries[4].query == "analyze" && !queries[4].backend);
+  CHECK(queries[5].query == "find_best_move_limited" &&
+        queries[5].max_nodes == 5000);
+  CHECK(queries[6].query == "principal_variation" &&
+        !queries[6].result.empty());
+  for (size_t i = 0; i < queries.size(); i++) {
+    CHECK(queries[i].result == results[i]);
+  }
+
+  // replaying on solvers rebuilt from the trace gives the recorded results
+  std::map<int, std::unique_ptr<Solver>> replay_solvers;
+  for (const TraceSolver &trace_solver : solvers) {
+    SolverConfig config = trace_solver.config;
+    config.seed = trace_solver.seed;
+    replay_solvers[trace_solver.id] = std::make_unique<Solver>(config);
+  }
+  std::vector<int> result;
+  for (const TraceQuery &query : queries) {
+    CHECK(ReplayQuery(*replay_solvers.at(query.solver), query, result));
+    CHECK(result == query.result);
+  }
+  TraceQuery unknown = queries.front();
+  unknown.query = "unknown";
+  CHECK(!ReplayQuery(*replay_solvers.at(unknown.solver), unknown, result));
+
+  std::remove(TRACE_PATH.c_str());
+  return Failures() == 0 ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+#include <vector>
+
+#include "check.hpp"
+#include "core/position.hpp"
+#include "core/solver.hpp"
+#include "core/zugzwang_rules.hpp"
+
+int main() {
+  SolverConfig config;
+  config.table_size = 1 << 20;
+  Solver solver(config);
+
+  // ProvesNoWin has to be sound: a proved position is never won by the
+  // player to move
+  int first_player_positions = 0;
+  int proofs = 0;
+  for (const Position &pos : RandomPositions(600, 24, 38, 3)) {
+    const bool proved = ProvesNoWin(pos);
+    if (pos.NumMoves() % 2 != 0) {
+      CHECK(!proved);  // the rules only cover the first player to move
+      continue;
+    }
+    first_player_positions++;
+    if (proved) {
+      proofs++;
+      solver.Reset();
+      CHECK(solver.Solve(pos) <= 0);
+    }
+  }
+
+  // and useful: it proves a fair share of the late positions
+  CHECK(proofs * 10 > first_player_positions);
+
+  // the solver using the rules finds the same scores
+  config.zugzwang_rules = true;
+  Solver zugzwang_solver(config);
+  for (const Position &pos : RandomPositions(100, 20, 30, 4)) {
+    solver.Reset();
+    zugzwang_solver.Reset();
+    CHECK(zugzwang_solver.Solve(pos) == solver.Solve(pos));
+  }
+  return Failures() == 0 ? 0 : 1;
+}